@@ -0,0 +1,126 @@
+/**
+ * @file debounce_bitslice.c
+ * @author astro
+ *  per key eager debouncing with bit sliced counters
+ *
+ * A key change is reported on its first edge, then the key is locked for
+ * DEBOUNCE milliseconds. The lock counters are stored as bit planes of
+ * matrix_row_t, plane b holding bit b of the counters of a whole row, so a
+ * single word operation updates the counters of every key in the row.
+ *
+ * Selected with DEBOUNCE_TYPE = bitslice_eager_pk
+ */
+
+#include <string.h>
+
+#include "matrix.h"
+#include "debounce.h"
+#include "timer.h"
+
+#ifndef DEBOUNCE
+#   define DEBOUNCE 5
+#endif
+
+#if DEBOUNCE > 255
+#   error DEBOUNCE must be 255 or less
+#elif DEBOUNCE > 127
+#   define DEBOUNCE_BITS 8
+#elif DEBOUNCE > 63
+#   define DEBOUNCE_BITS 7
+#elif DEBOUNCE > 31
+#   define DEBOUNCE_BITS 6
+#elif DEBOUNCE > 15
+#   define DEBOUNCE_BITS 5
+#elif DEBOUNCE > 7
+#   define DEBOUNCE_BITS 4
+#elif DEBOUNCE > 3
+#   define DEBOUNCE_BITS 3
+#elif DEBOUNCE > 1
+#   define DEBOUNCE_BITS 2
+#else
+#   define DEBOUNCE_BITS 1
+#endif
+
+static matrix_row_t counters[DEBOUNCE_BITS][MATRIX_ROWS];
+static bool counting = false;
+static uint16_t last_time = 0;
+
+void debounce_init(uint8_t num_rows)
+{
+    memset(counters, 0, sizeof(counters));
+    counting = false;
+    last_time = timer_read();
+}
+
+void debounce_free(void) {}
+
+static inline matrix_row_t debounce_active(uint8_t row)
+{
+    matrix_row_t active = 0;
+    for (uint8_t b = 0; b < DEBOUNCE_BITS; b++) {
+        active |= counters[b][row];
+    }
+    return active;
+}
+
+// decrement every running counter of the row by one
+static inline void debounce_tick(uint8_t row, matrix_row_t active)
+{
+    matrix_row_t borrow = active;
+    for (uint8_t b = 0; b < DEBOUNCE_BITS && borrow; b++) {
+        matrix_row_t plane = counters[b][row];
+        counters[b][row] = plane ^ borrow;
+        borrow &= ~plane;
+    }
+}
+
+// (re)start the counters of the given keys at DEBOUNCE
+static inline void debounce_start(uint8_t row, matrix_row_t keys)
+{
+    for (uint8_t b = 0; b < DEBOUNCE_BITS; b++) {
+        if (DEBOUNCE & (1 << b)) {
+            counters[b][row] |= keys;
+        } else {
+            counters[b][row] &= ~keys;
+        }
+    }
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed)
+{
+    uint16_t now = timer_read();
+    uint16_t elapsed = TIMER_DIFF_16(now, last_time);
+    last_time = now;
+
+    if (!changed && !counting) {
+        return false;
+    }
+
+    if (elapsed > DEBOUNCE) {
+        elapsed = DEBOUNCE;
+    }
+
+    bool cooked_changed = false;
+    counting = false;
+    for (uint8_t row = 0; row < num_rows; row++) {
+        matrix_row_t active = debounce_active(row);
+        for (uint16_t i = 0; i < elapsed && active; i++) {
+            debounce_tick(row, active);
+            active = debounce_active(row);
+        }
+
+        matrix_row_t edges = (raw[row] ^ cooked[row]) & ~active;
+        if (edges) {
+            cooked[row] ^= edges;
+            debounce_start(row, edges);
+            active |= edges;
+            cooked_changed = true;
+        }
+
+        if (active) {
+            counting = true;
+        }
+    }
+
+    return cooked_changed;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file amk_gpio.h
+ * @author astro
+ *  host stand-in for the gpio, see qmk_host.mk
+ *
+ * Pins are numbered HOST_PIN(port, bit). The input levels come from the
+ * simulated key switches of host_platform.h: a row pin reads high while a
+ * pressed key connects it to a column pin driven high. Edge wakeups fire
+ * their callback as soon as a level change is simulated.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t pin_t;
+
+#define HOST_PIN(port, bit) ((pin_t)(((port) << 5) | (bit)))
+#define GPIO_PIN_PORT(pin)  ((pin) >> 5)
+#define GPIO_PIN_BIT(pin)   ((pin) & 0x1F)
+#define HOST_GPIO_PORTS     8
+
+#define NO_PIN (~(pin_t)0)
+
+// the edge wakeups below are there, see matrix_scan.c
+#define AMK_GPIO_EDGE_WAKEUP
+
+typedef enum {
+    GPIO_EDGE_RISING,
+    GPIO_EDGE_FALLING,
+    GPIO_EDGE_BOTH,
+} gpio_edge_t;
+
+typedef void (*gpio_edge_callback_t)(pin_t pin);
+
+void gpio_set_output_pushpull(pin_t pin);
+void gpio_set_output_opendrain(pin_t pin);
+void gpio_set_input_floating(pin_t pin);
+void gpio_set_input_pullup(pin_t pin);
+void gpio_set_input_pulldown(pin_t pin);
+void gpio_write_pin(pin_t pin, uint8_t level);
+uint8_t gpio_read_pin(pin_t pin);
+uint32_t gpio_read_port(uint32_t port);
+
+/* wake the mcu and call callback on an edge of an input pin */
+void gpio_enable_edge_wakeup(pin_t pin, gpio_edge_t edge, gpio_edge_callback_t callback);
+void gpio_disable_edge_wakeup(pin_t pin);
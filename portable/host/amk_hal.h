@@ -0,0 +1,15 @@
+/**
+ * @file amk_hal.h
+ * @author astro
+ *  host stand-in for the platform hal, see qmk_host.mk
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define __disable_irq()
+#define __enable_irq()
@@ -0,0 +1,11 @@
+/**
+ * @file amk_printf.h
+ * @author astro
+ *  host stand-in for the debug output, see qmk_host.mk
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#define amk_printf printf
@@ -0,0 +1,12 @@
+/**
+ * @file amk_usb.h
+ * @author astro
+ *  host stand-in for the usb interfaces, see qmk_host.mk
+ */
+
+#pragma once
+
+#include "usb_interface.h"
+
+bool amk_usb_itf_ready(uint32_t type);
+bool amk_usb_itf_send_report(uint32_t report_type, const void *data, uint32_t size);
@@ -0,0 +1,574 @@
+/**
+ * @file host_platform.c
+ * @author astro
+ *  in memory platform for the host native build
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "host_platform.h"
+#include "amk_gpio.h"
+#include "amk_usb.h"
+#include "host.h"
+#include "timer.h"
+#include "wait.h"
+#include "eeprom.h"
+#include "log_store.h"
+
+#ifndef TOTAL_EEPROM_BYTE_COUNT
+#   define TOTAL_EEPROM_BYTE_COUNT 4096
+#endif
+
+// the scan may advance the clock from a thread of its own, see test_key_event_queue.c
+static uint64_t time_us;
+
+static uint64_t time_now(void)
+{
+    return __atomic_load_n(&time_us, __ATOMIC_RELAXED);
+}
+
+static void time_advance(uint64_t us)
+{
+    __atomic_fetch_add(&time_us, us, __ATOMIC_RELAXED);
+}
+
+static uint32_t gpio_output[HOST_GPIO_PORTS];
+static uint32_t gpio_level[HOST_GPIO_PORTS];
+static uint32_t gpio_pullup[HOST_GPIO_PORTS];
+static uint32_t gpio_wakeups;
+
+static pin_t matrix_row_pins[] = MATRIX_ROW_PINS;
+static pin_t matrix_col_pins[] = MATRIX_COL_PINS;
+static bool matrix_keys[MATRIX_ROWS][MATRIX_COLS];
+static uint32_t matrix_settle_us[MATRIX_COLS];
+static uint64_t gpio_rise_time[HOST_GPIO_PORTS][32];
+
+#ifndef HOST_GPIO_EDGE_COUNT
+#   define HOST_GPIO_EDGE_COUNT 32
+#endif
+
+typedef struct {
+    pin_t pin;
+    gpio_edge_t edge;
+    gpio_edge_callback_t callback;
+    uint8_t level;
+} gpio_edge_wakeup_t;
+
+static gpio_edge_wakeup_t gpio_edges[HOST_GPIO_EDGE_COUNT];
+static uint8_t gpio_edge_count;
+
+static uint8_t eeprom_data[TOTAL_EEPROM_BYTE_COUNT];
+static uint32_t eeprom_writes;
+static uint32_t eeprom_accesses;
+static uint32_t eeprom_access_us;
+static uint32_t eeprom_read_byte_us;
+static uint32_t eeprom_write_byte_us;
+
+static uint8_t flash_banks[2][LOG_STORE_BANK_SIZE];
+static uint32_t flash_erases;
+static uint32_t flash_programs;
+
+static host_report_t report_log[HOST_REPORT_LOG_SIZE];
+static uint32_t report_log_count;
+
+static void report_log_append(uint8_t type, const void *data, size_t size)
+{
+    if (report_log_count >= HOST_REPORT_LOG_SIZE) {
+        return;
+    }
+
+    host_report_t *report = &report_log[report_log_count++];
+    report->time_us = time_now();
+    report->type = type;
+    report->size = size < HOST_REPORT_MAX_SIZE ? size : HOST_REPORT_MAX_SIZE;
+    memcpy(report->data, data, report->size);
+}
+
+// time
+uint64_t host_time_us(void)
+{
+    return time_now();
+}
+
+void host_time_advance_us(uint32_t us)
+{
+    time_advance(us);
+}
+
+void timer_init(void) {}
+
+void timer_clear(void)
+{
+    __atomic_store_n(&time_us, 0, __ATOMIC_RELAXED);
+}
+
+uint16_t timer_read(void)
+{
+    return (uint16_t)(time_now() / 1000);
+}
+
+uint32_t timer_read32(void)
+{
+    return (uint32_t)(time_now() / 1000);
+}
+
+__attribute__((weak))
+uint16_t timer_elapsed(uint16_t last)
+{
+    return TIMER_DIFF_16(timer_read(), last);
+}
+
+__attribute__((weak))
+uint32_t timer_elapsed32(uint32_t last)
+{
+    return TIMER_DIFF_32(timer_read32(), last);
+}
+
+#ifdef DEBUG_KEYSTROKE_COST
+// cpu time in nanoseconds for the keystroke cost, see keyboard.c
+uint32_t keystroke_cost_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+#endif
+
+void wait_ms(int ms)
+{
+    time_advance((uint64_t)ms * 1000);
+}
+
+void wait_us(int us)
+{
+    time_advance(us);
+}
+
+// gpio
+static bool pin_is_output(pin_t pin)
+{
+    return gpio_output[GPIO_PIN_PORT(pin)] & (1UL << GPIO_PIN_BIT(pin));
+}
+
+static uint8_t pin_level(pin_t pin)
+{
+    return (gpio_level[GPIO_PIN_PORT(pin)] >> GPIO_PIN_BIT(pin)) & 1;
+}
+
+static void pin_set(uint32_t *bits, pin_t pin, bool set)
+{
+    if (set) {
+        bits[GPIO_PIN_PORT(pin)] |= 1UL << GPIO_PIN_BIT(pin);
+    } else {
+        bits[GPIO_PIN_PORT(pin)] &= ~(1UL << GPIO_PIN_BIT(pin));
+    }
+}
+
+void gpio_set_output_pushpull(pin_t pin)
+{
+    pin_set(gpio_output, pin, true);
+}
+
+void gpio_set_output_opendrain(pin_t pin)
+{
+    pin_set(gpio_output, pin, true);
+}
+
+void gpio_set_input_floating(pin_t pin)
+{
+    pin_set(gpio_output, pin, false);
+    pin_set(gpio_pullup, pin, false);
+}
+
+void gpio_set_input_pullup(pin_t pin)
+{
+    pin_set(gpio_output, pin, false);
+    pin_set(gpio_pullup, pin, true);
+}
+
+void gpio_set_input_pulldown(pin_t pin)
+{
+    pin_set(gpio_output, pin, false);
+    pin_set(gpio_pullup, pin, false);
+}
+
+static void gpio_edge_update(void);
+
+void gpio_write_pin(pin_t pin, uint8_t level)
+{
+    if (level && !pin_level(pin)) {
+        gpio_rise_time[GPIO_PIN_PORT(pin)][GPIO_PIN_BIT(pin)] = time_now();
+    }
+    pin_set(gpio_level, pin, level);
+    gpio_edge_update();
+}
+
+/*
+ * An input connected through pressed keys to outputs reads high when one
+ * of them drives high, as through the diodes of the matrix, low when they
+ * all drive low, otherwise its pull. A column driven high only reads so
+ * through a key once its settle time passed.
+ */
+uint8_t gpio_read_pin(pin_t pin)
+{
+    if (pin_is_output(pin)) {
+        return pin_level(pin);
+    }
+
+    bool driven = false;
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        for (int col = 0; col < MATRIX_COLS; col++) {
+            if (!matrix_keys[row][col]) {
+                continue;
+            }
+
+            pin_t other = NO_PIN;
+            if (matrix_row_pins[row] == pin) {
+                other = matrix_col_pins[col];
+            } else if (matrix_col_pins[col] == pin) {
+                other = matrix_row_pins[row];
+            }
+
+            if (other != NO_PIN && pin_is_output(other)) {
+                uint64_t rise = gpio_rise_time[GPIO_PIN_PORT(other)][GPIO_PIN_BIT(other)];
+                if (pin_level(other) && time_now() - rise >= matrix_settle_us[col]) {
+                    return 1;
+                }
+                driven = true;
+            }
+        }
+    }
+
+    if (driven) {
+        return 0;
+    }
+    return (gpio_pullup[GPIO_PIN_PORT(pin)] >> GPIO_PIN_BIT(pin)) & 1;
+}
+
+uint32_t gpio_read_port(uint32_t port)
+{
+    uint32_t value = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        if (gpio_read_pin(HOST_PIN(port, bit))) {
+            value |= 1UL << bit;
+        }
+    }
+    return value;
+}
+
+// edge wakeups, checked after every simulated level change
+void gpio_enable_edge_wakeup(pin_t pin, gpio_edge_t edge, gpio_edge_callback_t callback)
+{
+    uint8_t i = 0;
+    while (i < gpio_edge_count && gpio_edges[i].pin != pin) i++;
+    if (i == HOST_GPIO_EDGE_COUNT) {
+        return;
+    }
+    if (i == gpio_edge_count) {
+        gpio_edge_count++;
+    }
+
+    gpio_edges[i].pin = pin;
+    gpio_edges[i].edge = edge;
+    gpio_edges[i].callback = callback;
+    gpio_edges[i].level = gpio_read_pin(pin);
+}
+
+void gpio_disable_edge_wakeup(pin_t pin)
+{
+    for (uint8_t i = 0; i < gpio_edge_count; i++) {
+        if (gpio_edges[i].pin == pin) {
+            gpio_edges[i] = gpio_edges[--gpio_edge_count];
+            return;
+        }
+    }
+}
+
+static void gpio_edge_update(void)
+{
+    for (uint8_t i = 0; i < gpio_edge_count; i++) {
+        gpio_edge_wakeup_t *wakeup = &gpio_edges[i];
+        uint8_t level = gpio_read_pin(wakeup->pin);
+        if (level == wakeup->level) {
+            continue;
+        }
+
+        wakeup->level = level;
+        if (wakeup->edge == GPIO_EDGE_BOTH || (wakeup->edge == GPIO_EDGE_RISING) == (level != 0)) {
+            gpio_wakeups++;
+            wakeup->callback(wakeup->pin);
+        }
+    }
+}
+
+uint32_t host_gpio_wakeups(void)
+{
+    return gpio_wakeups;
+}
+
+void host_matrix_set_key(uint8_t row, uint8_t col, bool pressed)
+{
+    if (row < MATRIX_ROWS && col < MATRIX_COLS) {
+        matrix_keys[row][col] = pressed;
+        gpio_edge_update();
+    }
+}
+
+void host_matrix_set_settle_us(uint8_t col, uint32_t us)
+{
+    if (col < MATRIX_COLS) {
+        matrix_settle_us[col] = us;
+    }
+}
+
+void host_matrix_clear(void)
+{
+    memset(matrix_keys, 0, sizeof(matrix_keys));
+    gpio_edge_update();
+}
+
+// eeprom
+uint8_t *host_eeprom_data(void)
+{
+    return eeprom_data;
+}
+
+size_t host_eeprom_size(void)
+{
+    return sizeof(eeprom_data);
+}
+
+uint32_t host_eeprom_writes(void)
+{
+    return eeprom_writes;
+}
+
+uint32_t host_eeprom_accesses(void)
+{
+    return eeprom_accesses;
+}
+
+void host_eeprom_set_cost(uint32_t access_us, uint32_t read_byte_us, uint32_t write_byte_us)
+{
+    eeprom_access_us = access_us;
+    eeprom_read_byte_us = read_byte_us;
+    eeprom_write_byte_us = write_byte_us;
+}
+
+static uintptr_t eeprom_offset(const void *addr, size_t size)
+{
+    uintptr_t offset = (uintptr_t)addr;
+    return offset + size <= sizeof(eeprom_data) ? offset : sizeof(eeprom_data);
+}
+
+void eeprom_read_block(void *buf, const void *addr, size_t len)
+{
+    uintptr_t offset = eeprom_offset(addr, len);
+    eeprom_accesses++;
+    time_advance(eeprom_access_us + (uint64_t)eeprom_read_byte_us * len);
+    if (offset < sizeof(eeprom_data)) {
+        memcpy(buf, &eeprom_data[offset], len);
+    } else {
+        memset(buf, 0xFF, len);
+    }
+}
+
+void eeprom_write_block(const void *buf, void *addr, size_t len)
+{
+    uintptr_t offset = eeprom_offset(addr, len);
+    eeprom_accesses++;
+    time_advance(eeprom_access_us + (uint64_t)eeprom_write_byte_us * len);
+    if (offset < sizeof(eeprom_data)) {
+        memcpy(&eeprom_data[offset], buf, len);
+        eeprom_writes++;
+    }
+}
+
+void eeprom_update_block(const void *buf, void *addr, size_t len)
+{
+    uintptr_t offset = eeprom_offset(addr, len);
+    eeprom_accesses++;
+    time_advance(eeprom_access_us + (uint64_t)eeprom_read_byte_us * len);
+    if (offset < sizeof(eeprom_data) && memcmp(&eeprom_data[offset], buf, len)) {
+        eeprom_write_block(buf, addr, len);
+    }
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    uint8_t value;
+    eeprom_read_block(&value, addr, sizeof(value));
+    return value;
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr)
+{
+    uint16_t value;
+    eeprom_read_block(&value, addr, sizeof(value));
+    return value;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *addr)
+{
+    uint32_t value;
+    eeprom_read_block(&value, addr, sizeof(value));
+    return value;
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_word(uint16_t *addr, uint16_t value)
+{
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_dword(uint32_t *addr, uint32_t value)
+{
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+    eeprom_update_block(&value, addr, sizeof(value));
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value)
+{
+    eeprom_update_block(&value, addr, sizeof(value));
+}
+
+void eeprom_update_dword(uint32_t *addr, uint32_t value)
+{
+    eeprom_update_block(&value, addr, sizeof(value));
+}
+
+// flash banks of the log store, with the bit clearing programming of nor flash
+uint32_t host_flash_erases(void)
+{
+    return flash_erases;
+}
+
+uint32_t host_flash_programs(void)
+{
+    return flash_programs;
+}
+
+void log_store_flash_read(uint8_t bank, uint32_t offset, void *data, uint32_t size)
+{
+    if (bank < 2 && offset + size <= LOG_STORE_BANK_SIZE) {
+        memcpy(data, &flash_banks[bank][offset], size);
+    } else {
+        memset(data, 0xFF, size);
+    }
+}
+
+void log_store_flash_program(uint8_t bank, uint32_t offset, const void *data, uint32_t size)
+{
+    if (bank < 2 && offset + size <= LOG_STORE_BANK_SIZE) {
+        const uint8_t *source = data;
+        for (uint32_t i = 0; i < size; i++) {
+            flash_banks[bank][offset + i] &= source[i];
+        }
+        flash_programs++;
+    }
+}
+
+void log_store_flash_erase(uint8_t bank)
+{
+    if (bank < 2) {
+        memset(flash_banks[bank], 0xFF, sizeof(flash_banks[bank]));
+        flash_erases++;
+    }
+}
+
+// usb
+void usb_send_report(uint8_t report_type, const void *data, size_t size)
+{
+    report_log_append(report_type, data, size);
+}
+
+bool amk_usb_itf_ready(uint32_t type)
+{
+    return true;
+}
+
+bool amk_usb_itf_send_report(uint32_t report_type, const void *data, uint32_t size)
+{
+    report_log_append(report_type, data, size);
+    return true;
+}
+
+static uint8_t host_keyboard_leds_state(void)
+{
+    return 0;
+}
+
+static void host_send_keyboard(report_keyboard_t *report)
+{
+    report_log_append(HID_REPORT_ID_KEYBOARD, report, sizeof(*report));
+}
+
+static void host_send_nkro(report_nkro_t *report)
+{
+    report_log_append(HID_REPORT_ID_NKRO, report, sizeof(*report));
+}
+
+static void host_send_mouse(report_mouse_t *report)
+{
+    report_log_append(HID_REPORT_ID_MOUSE, report, sizeof(*report));
+}
+
+static void host_send_extra(report_extra_t *report)
+{
+    uint8_t type = report->report_id == REPORT_ID_CONSUMER ? HID_REPORT_ID_CONSUMER : HID_REPORT_ID_SYSTEM;
+    report_log_append(type, report, sizeof(*report));
+}
+
+static host_driver_t host_platform_driver = {
+    host_keyboard_leds_state,
+    host_send_keyboard,
+    host_send_nkro,
+    host_send_mouse,
+    host_send_extra,
+};
+
+uint32_t host_report_count(void)
+{
+    return report_log_count;
+}
+
+const host_report_t *host_report_get(uint32_t index)
+{
+    return index < report_log_count ? &report_log[index] : NULL;
+}
+
+void host_report_clear(void)
+{
+    report_log_count = 0;
+}
+
+void host_platform_init(void)
+{
+    __atomic_store_n(&time_us, 0, __ATOMIC_RELAXED);
+    memset(gpio_output, 0, sizeof(gpio_output));
+    memset(gpio_level, 0, sizeof(gpio_level));
+    memset(gpio_pullup, 0, sizeof(gpio_pullup));
+    memset(gpio_rise_time, 0, sizeof(gpio_rise_time));
+    gpio_edge_count = 0;
+    gpio_wakeups = 0;
+    memset(matrix_settle_us, 0, sizeof(matrix_settle_us));
+    host_matrix_clear();
+    memset(eeprom_data, 0xFF, sizeof(eeprom_data));
+    eeprom_writes = 0;
+    eeprom_accesses = 0;
+    host_eeprom_set_cost(0, 0, 0);
+    memset(flash_banks, 0xFF, sizeof(flash_banks));
+    flash_erases = 0;
+    flash_programs = 0;
+    host_report_clear();
+    host_set_driver(&host_platform_driver);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file host_platform.h
+ * @author astro
+ *  in memory platform for the host native build, see qmk_host.mk
+ *
+ * Stands in for the gpio, eeprom, timer and usb of the firmware. Time
+ * only moves through host_time_advance_us() and the wait functions, so
+ * runs are reproducible. Everything sent to the host is appended to a
+ * report log with the time it was sent.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef HOST_REPORT_LOG_SIZE
+#   define HOST_REPORT_LOG_SIZE 4096
+#endif
+
+#ifndef HOST_REPORT_MAX_SIZE
+#   define HOST_REPORT_MAX_SIZE 64
+#endif
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t type;
+    uint8_t size;
+    uint8_t data[HOST_REPORT_MAX_SIZE];
+} host_report_t;
+
+/* reset the platform state and install the capturing host driver */
+void host_platform_init(void);
+
+uint64_t host_time_us(void);
+void host_time_advance_us(uint32_t us);
+
+/* simulated key switch between the row and column pins of the matrix */
+void host_matrix_set_key(uint8_t row, uint8_t col, bool pressed);
+void host_matrix_clear(void);
+/*
+ * microseconds a driven column takes to reach the rows through its keys,
+ * 0 by default. The edge wakeups do not see the delay.
+ */
+void host_matrix_set_settle_us(uint8_t col, uint32_t us);
+
+/* edge wakeups fired through amk_gpio, e.g. leaving the idle scanning */
+uint32_t host_gpio_wakeups(void);
+
+uint8_t *host_eeprom_data(void);
+size_t host_eeprom_size(void);
+uint32_t host_eeprom_writes(void);
+/* eeprom calls of any kind, what the per access cost is charged for */
+uint32_t host_eeprom_accesses(void);
+/*
+ * simulated access time of the eeprom, every call advances the clock by
+ * access_us plus the per byte cost, so the time of a keymap sync can be
+ * read from host_time_us(). Free after host_platform_init().
+ */
+void host_eeprom_set_cost(uint32_t access_us, uint32_t read_byte_us, uint32_t write_byte_us);
+
+/* flash banks of the log store, see log_store.h */
+uint32_t host_flash_erases(void);
+uint32_t host_flash_programs(void);
+
+/* reports captured since the last clear, oldest first */
+uint32_t host_report_count(void);
+const host_report_t *host_report_get(uint32_t index);
+void host_report_clear(void);
@@ -0,0 +1,164 @@
+/**
+ * @file bench_eeprom_keymap.c
+ * @author astro
+ *  time of a full keymap read and write through the eeprom model
+ *
+ * Syncs the whole dynamic keymap in the 28 byte chunks Vial sends, once
+ * with the byte at a time updates the keymap used to do, once with an
+ * eeprom_update_block() per chunk and once through
+ * dynamic_keymap_set_buffer(). Every eeprom call costs EEPROM_ACCESS_US,
+ * every byte EEPROM_READ_BYTE_US or EEPROM_WRITE_BYTE_US on the simulated
+ * clock, so the output is the same on every run.
+ */
+
+#include <string.h>
+
+#include "host_test.h"
+#include "eeprom.h"
+#include "dynamic_keymap.h"
+
+#define EEPROM_ACCESS_US        15
+#define EEPROM_READ_BYTE_US     1
+#define EEPROM_WRITE_BYTE_US    40
+
+#define KEYMAP_SIZE             (DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2)
+#define CHUNK_SIZE              28
+
+static uint8_t original[KEYMAP_SIZE];
+static uint8_t image[KEYMAP_SIZE];
+// the keymap in the eeprom model, and its eeprom address
+static uint8_t *stored;
+static uint8_t *address;
+
+typedef struct {
+    uint64_t us;
+    uint32_t accesses;
+} cost_t;
+
+static cost_t cost_start(void)
+{
+    return (cost_t){host_time_us(), host_eeprom_accesses()};
+}
+
+static cost_t cost_since(cost_t start)
+{
+    return (cost_t){host_time_us() - start.us, host_eeprom_accesses() - start.accesses};
+}
+
+static void keymap_restore(void)
+{
+    host_eeprom_set_cost(0, 0, 0);
+    for (uint16_t offset = 0; offset < KEYMAP_SIZE; offset += CHUNK_SIZE) {
+        uint16_t size = KEYMAP_SIZE - offset < CHUNK_SIZE ? KEYMAP_SIZE - offset : CHUNK_SIZE;
+        dynamic_keymap_set_buffer(offset, size, original + offset);
+    }
+    host_eeprom_set_cost(EEPROM_ACCESS_US, EEPROM_READ_BYTE_US, EEPROM_WRITE_BYTE_US);
+}
+
+static void write_bytes(uint16_t offset, uint16_t size, uint8_t *data)
+{
+    for (uint16_t i = 0; i < size; i++) {
+        eeprom_update_byte(address + offset + i, data[i]);
+    }
+}
+
+static void write_block(uint16_t offset, uint16_t size, uint8_t *data)
+{
+    eeprom_update_block(data, address + offset, size);
+}
+
+static void write_keymap(uint16_t offset, uint16_t size, uint8_t *data)
+{
+    dynamic_keymap_set_buffer(offset, size, data);
+}
+
+static cost_t sync(void (*write)(uint16_t offset, uint16_t size, uint8_t *data))
+{
+    uint8_t chunk[CHUNK_SIZE];
+    keymap_restore();
+    cost_t start = cost_start();
+    for (uint16_t offset = 0; offset < KEYMAP_SIZE; offset += CHUNK_SIZE) {
+        uint16_t size = KEYMAP_SIZE - offset < CHUNK_SIZE ? KEYMAP_SIZE - offset : CHUNK_SIZE;
+        // set_buffer may rewrite the chunk, e.g. a locked QK_BOOT
+        memcpy(chunk, image + offset, size);
+        write(offset, size, chunk);
+    }
+    cost_t cost = cost_since(start);
+    HOST_CHECK(memcmp(stored, image, KEYMAP_SIZE) == 0);
+    return cost;
+}
+
+static void print_cost(cost_t cost)
+{
+    printf("%9.2f ms %4lu calls", cost.us / 1000.0, (unsigned long)cost.accesses);
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    // find the keymap in the eeprom by a pattern no keymap has
+    for (uint16_t i = 0; i < KEYMAP_SIZE; i++) {
+        image[i] = (i * 7 + 3) ^ 0xa5;
+    }
+    memcpy(original, image, KEYMAP_SIZE);
+    keymap_restore();
+    for (size_t i = 0; !stored && i + KEYMAP_SIZE <= host_eeprom_size(); i++) {
+        if (memcmp(host_eeprom_data() + i, image, KEYMAP_SIZE) == 0) {
+            stored = host_eeprom_data() + i;
+        }
+    }
+    HOST_CHECK(stored != NULL);
+    address = (uint8_t *)(uintptr_t)(stored - host_eeprom_data());
+
+    // a keymap to start the writes from, every keycode distinct
+    for (uint16_t i = 0; i < KEYMAP_SIZE; i += 2) {
+        original[i] = 0x00;
+        original[i + 1] = 0x04 + (i / 2) % 0x60;
+    }
+
+    printf("%u byte keymap in %u byte chunks, eeprom %u us per call, %u/%u us per byte read/written\n",
+           KEYMAP_SIZE, CHUNK_SIZE, EEPROM_ACCESS_US, EEPROM_READ_BYTE_US, EEPROM_WRITE_BYTE_US);
+
+    static const struct {
+        const char *name;
+        uint16_t every;
+    } workloads[] = {
+        {"identical", 0},
+        {"10% changed", 10},
+        {"all changed", 1},
+    };
+    for (unsigned w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        memcpy(image, original, KEYMAP_SIZE);
+        for (uint16_t key = 0; workloads[w].every && key < KEYMAP_SIZE / 2; key += workloads[w].every) {
+            image[key * 2 + 1] ^= 0x80;
+        }
+        printf("write %-12s byte update ", workloads[w].name);
+        print_cost(sync(write_bytes));
+        printf(", block update ");
+        print_cost(sync(write_block));
+        printf(", set_buffer ");
+        print_cost(sync(write_keymap));
+        printf("\n");
+    }
+
+    uint8_t chunk[CHUNK_SIZE];
+    memcpy(image, original, KEYMAP_SIZE);
+    keymap_restore();
+    cost_t start = cost_start();
+    for (uint16_t i = 0; i < KEYMAP_SIZE; i++) {
+        HOST_CHECK(eeprom_read_byte(address + i) == image[i]);
+    }
+    printf("read  %-12s byte read   ", "");
+    print_cost(cost_since(start));
+    start = cost_start();
+    for (uint16_t offset = 0; offset < KEYMAP_SIZE; offset += CHUNK_SIZE) {
+        uint16_t size = KEYMAP_SIZE - offset < CHUNK_SIZE ? KEYMAP_SIZE - offset : CHUNK_SIZE;
+        dynamic_keymap_get_buffer(offset, size, chunk);
+        HOST_CHECK(memcmp(chunk, image + offset, size) == 0);
+    }
+    printf(", get_buffer ");
+    print_cost(cost_since(start));
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file bench_keystroke_cost.c
+ * @author astro
+ *  replays typing traces through the whole firmware, see traces/
+ *
+ * Every millisecond of a trace sets its key edges on the simulated matrix
+ * and runs the main loop once, so the edges go through matrix_task(),
+ * action_exec() and host_keyboard_send() as on the keyboard. Prints, per
+ * trace:
+ *
+ *   cpu per keystroke       thread cpu time of the main loop over the
+ *                           replay, idle milliseconds included, divided
+ *                           by the key presses
+ *   reports per keystroke   reports sent to the host per key press
+ *   latency p50/p99         milliseconds from a key edge to the next report
+ *
+ * tests.mk builds it once per feature set, the differences between the
+ * builds are what a feature costs on the hot path.
+ */
+
+#include <time.h>
+
+#include "host_test.h"
+
+#define TRACE_EVENTS_MAX    65536
+// time after the last edge for the pending taps and combos to resolve
+#define TRACE_TAIL_MS       1000
+
+typedef struct {
+    uint32_t ms;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+} trace_event_t;
+
+static trace_event_t trace[TRACE_EVENTS_MAX];
+static uint32_t trace_count;
+
+static uint32_t latencies[TRACE_EVENTS_MAX];
+static uint32_t latency_count;
+
+static uint32_t trace_read(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("%s: cannot open\n", path);
+        exit(1);
+    }
+
+    char line[128];
+    trace_count = 0;
+    while (fgets(line, sizeof(line), file)) {
+        unsigned ms, row, col;
+        char edge;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        HOST_CHECK(trace_count < TRACE_EVENTS_MAX);
+        HOST_CHECK(sscanf(line, "%u %u %u %c", &ms, &row, &col, &edge) == 4);
+        HOST_CHECK(row < MATRIX_ROWS && col < MATRIX_COLS && (edge == 'd' || edge == 'u'));
+        HOST_CHECK(trace_count == 0 || ms >= trace[trace_count - 1].ms);
+        trace[trace_count++] = (trace_event_t){ms, row, col, edge == 'd'};
+    }
+    fclose(file);
+    return trace_count;
+}
+
+static uint64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(uint8_t percent)
+{
+    return latency_count ? latencies[(latency_count - 1) * percent / 100] : 0;
+}
+
+static void replay(const char *path)
+{
+    trace_read(path);
+    host_test_boot();
+    host_matrix_clear();
+
+    // edges still waiting for a report, oldest first
+    static uint32_t pending[TRACE_EVENTS_MAX];
+    uint32_t pending_count = 0;
+    uint32_t keystrokes = 0;
+    uint32_t reports = 0;
+    uint64_t cpu = 0;
+    uint32_t next = 0;
+    latency_count = 0;
+
+    const uint32_t end = trace_count ? trace[trace_count - 1].ms + TRACE_TAIL_MS : 0;
+    for (uint32_t ms = 0; ms <= end; ms++) {
+        for (; next < trace_count && trace[next].ms == ms; next++) {
+            host_matrix_set_key(trace[next].row, trace[next].col, trace[next].pressed);
+            keystrokes += trace[next].pressed;
+            pending[pending_count++] = ms;
+        }
+
+        const uint64_t start = cpu_ns();
+        qmk_driver_task();
+        cpu += cpu_ns() - start;
+
+        if (host_report_count()) {
+            reports += host_report_count();
+            host_report_clear();
+            for (uint32_t i = 0; i < pending_count; i++) {
+                latencies[latency_count++] = ms - pending[i];
+            }
+            pending_count = 0;
+        }
+        host_time_advance_us(1000);
+    }
+
+    qsort(latencies, latency_count, sizeof(latencies[0]), compare_u32);
+    printf("%s: %lu keystrokes, cpu per keystroke %lu ns, reports per keystroke %.2f, ",
+           path, (unsigned long)keystrokes, (unsigned long)(keystrokes ? cpu / keystrokes : 0), keystrokes ? (double)reports / keystrokes : 0.0);
+    printf("latency p50 %lu ms p99 %lu ms, %lu edges without report\n",
+           (unsigned long)percentile(50), (unsigned long)percentile(99), (unsigned long)pending_count);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("usage: %s <trace>...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        replay(argv[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file bench_log_store.c
+ * @author astro
+ *  flash erases of the log store per keymap workload, see log_store.h
+ *
+ * Runs the keymap writes a user makes through the dynamic keymap of a
+ * LOG_STORE_ENABLE build, with the main loop running in between so the
+ * write back cache flushes as on the keyboard. Prints the bank erases and
+ * programs of every workload next to the writes which changed data, the
+ * page erases an eeprom emulated in place would need. Runs on the
+ * simulated clock, so the output is the same on every run.
+ */
+
+#include <string.h>
+
+#include "host_test.h"
+#include "dynamic_keymap.h"
+#include "log_store.h"
+
+#define KEYMAP_SIZE     (DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2)
+#define CHUNK_SIZE      28
+#define MACRO_SIZE      1024
+
+static uint32_t changing_writes;
+static uint32_t random_state = 0x9e3779b9;
+
+static uint32_t random_next(void)
+{
+    random_state = random_state * 1664525 + 1013904223;
+    return random_state >> 8;
+}
+
+static void keymap_upload(void)
+{
+    uint8_t current[CHUNK_SIZE], chunk[CHUNK_SIZE];
+    for (uint16_t offset = 0; offset < KEYMAP_SIZE; offset += CHUNK_SIZE) {
+        uint16_t size = KEYMAP_SIZE - offset < CHUNK_SIZE ? KEYMAP_SIZE - offset : CHUNK_SIZE;
+        for (uint16_t i = 0; i < size; i += 2) {
+            chunk[i] = 0x00;
+            chunk[i + 1] = 0x04 + random_next() % 0x60;
+        }
+        dynamic_keymap_get_buffer(offset, size, current);
+        changing_writes += memcmp(current, chunk, size) != 0;
+        dynamic_keymap_set_buffer(offset, size, chunk);
+        host_test_run_ms(10);
+    }
+}
+
+static void key_remap(void)
+{
+    uint8_t layer = random_next() % DYNAMIC_KEYMAP_LAYER_COUNT;
+    uint8_t row = random_next() % MATRIX_ROWS;
+    uint8_t col = random_next() % MATRIX_COLS;
+    uint16_t keycode = 0x04 + random_next() % 0x60;
+    changing_writes += dynamic_keymap_get_keycode(layer, row, col) != keycode;
+    dynamic_keymap_set_keycode(layer, row, col, keycode);
+    host_test_run_ms(1500);
+}
+
+static void macro_upload(void)
+{
+    static uint8_t macros[MACRO_SIZE];
+    uint8_t current[CHUNK_SIZE];
+    const uint16_t size = dynamic_keymap_macro_get_buffer_size() < MACRO_SIZE ? dynamic_keymap_macro_get_buffer_size() : MACRO_SIZE;
+    HOST_CHECK(size > 0);
+
+    // plain text macros, each ending in its null
+    for (uint16_t i = 0; i < size; i++) {
+        macros[i] = random_next() % 16 ? 'a' + random_next() % 26 : 0;
+    }
+    macros[size - 1] = 0;
+    for (uint16_t offset = 0; offset < size; offset += CHUNK_SIZE) {
+        uint16_t chunk = size - offset < CHUNK_SIZE ? size - offset : CHUNK_SIZE;
+        dynamic_keymap_macro_get_buffer(offset, chunk, current);
+        changing_writes += memcmp(current, macros + offset, chunk) != 0;
+        dynamic_keymap_macro_set_buffer(offset, chunk, macros + offset);
+        host_test_run_ms(10);
+    }
+}
+
+static void run(const char *name, void (*workload)(void), uint32_t count)
+{
+    const uint32_t erases = host_flash_erases();
+    const uint32_t programs = host_flash_programs();
+    changing_writes = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        workload();
+    }
+    // past LOG_STORE_FLUSH_DELAY, the cache is written back
+    host_test_run_ms(LOG_STORE_FLUSH_DELAY * 2);
+
+    printf("%-18s %5lu writes changing data, log store %3lu erases %5lu programs\n", name,
+           (unsigned long)changing_writes, (unsigned long)(host_flash_erases() - erases), (unsigned long)(host_flash_programs() - programs));
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    printf("%u byte log store of %u byte blocks on two %u byte banks\n", LOG_STORE_SIZE, LOG_STORE_BLOCK_SIZE, LOG_STORE_BANK_SIZE);
+    run("3 keymap uploads", keymap_upload, 3);
+    run("2000 key remaps", key_remap, 2000);
+    run("50 macro uploads", macro_upload, 50);
+    return 0;
+}
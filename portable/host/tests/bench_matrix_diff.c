@@ -0,0 +1,208 @@
+/**
+ * @file bench_matrix_diff.c
+ * @author astro
+ *  cost of finding the changed keys of a scan, see matrix_task() of
+ *  protocol/keyboard.c
+ *
+ * Built once per geometry from MATRIX_ROWS and MATRIX_COLS, with the
+ * matrix_row_t keyboard.c gets for them. Compares the detection loops of
+ * matrix_task(), each followed by the walk over the changed columns:
+ *
+ *   early_exit  stop at the first changed row, then test every column
+ *   or_diff     or the row differences of the whole matrix, then visit
+ *               the changed columns by their lowest set bit
+ *   early_ctz   the detection of early_exit with the walk of or_diff
+ *
+ * on an idle matrix, one key edge every 16 scans, and every key toggling
+ * on every scan. Prints the best of several rounds in ns per scan.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if (MATRIX_COLS <= 8)
+typedef uint8_t matrix_row_t;
+#elif (MATRIX_COLS <= 16)
+typedef uint16_t matrix_row_t;
+#elif (MATRIX_COLS <= 32)
+typedef uint32_t matrix_row_t;
+#else
+typedef uint64_t matrix_row_t;
+#endif
+
+#if MATRIX_COLS > 32
+#   define MATRIX_ROW_CTZ(bits) __builtin_ctzll(bits)
+#else
+#   define MATRIX_ROW_CTZ(bits) __builtin_ctz(bits)
+#endif
+
+#define SCANS   (1u << 20)
+#define ROUNDS  7
+
+static matrix_row_t matrix[MATRIX_ROWS];
+static matrix_row_t matrix_previous[MATRIX_ROWS];
+static uint32_t events;
+
+// out of line like matrix_get_row() of the matrix scanner
+__attribute__((noinline)) static matrix_row_t matrix_get_row(uint8_t row)
+{
+    return matrix[row];
+}
+
+__attribute__((noinline)) static void key_event(uint8_t row, uint8_t col, bool pressed)
+{
+    events += pressed ? 2 : 1;
+}
+
+static bool task_early_exit(void)
+{
+    bool matrix_changed = false;
+    for (uint8_t row = 0; row < MATRIX_ROWS && !matrix_changed; row++) {
+        matrix_changed |= (matrix_previous[row] ^ matrix_get_row(row)) != 0;
+    }
+    if (!matrix_changed) {
+        return false;
+    }
+
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        const matrix_row_t current_row = matrix_get_row(row);
+        const matrix_row_t row_changes = current_row ^ matrix_previous[row];
+        if (!row_changes) {
+            continue;
+        }
+        matrix_row_t col_mask = 1;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++, col_mask <<= 1) {
+            if (row_changes & col_mask) {
+                key_event(row, col, current_row & col_mask);
+            }
+        }
+        matrix_previous[row] = current_row;
+    }
+    return true;
+}
+
+static void walk_ctz(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        const matrix_row_t current_row = matrix_get_row(row);
+        const matrix_row_t row_changes = current_row ^ matrix_previous[row];
+        if (!row_changes) {
+            continue;
+        }
+        for (matrix_row_t pending = row_changes; pending; pending &= pending - 1) {
+            const uint8_t      col      = MATRIX_ROW_CTZ(pending);
+            const matrix_row_t col_mask = ((matrix_row_t)1) << col;
+            key_event(row, col, current_row & col_mask);
+        }
+        matrix_previous[row] = current_row;
+    }
+}
+
+static bool task_or_diff(void)
+{
+    matrix_row_t matrix_diff = 0;
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_diff |= matrix_previous[row] ^ matrix_get_row(row);
+    }
+    if (!matrix_diff) {
+        return false;
+    }
+    walk_ctz();
+    return true;
+}
+
+static bool task_early_ctz(void)
+{
+    bool matrix_changed = false;
+    for (uint8_t row = 0; row < MATRIX_ROWS && !matrix_changed; row++) {
+        matrix_changed |= (matrix_previous[row] ^ matrix_get_row(row)) != 0;
+    }
+    if (!matrix_changed) {
+        return false;
+    }
+    walk_ctz();
+    return true;
+}
+
+typedef bool (*task_t)(void);
+
+static const struct {
+    const char *name;
+    task_t task;
+} tasks[] = {
+    {"early_exit", task_early_exit},
+    {"or_diff", task_or_diff},
+    {"early_ctz", task_early_ctz},
+};
+
+enum { IDLE, TYPING, ALL_KEYS, WORKLOADS };
+static const char *const workloads[] = {"idle", "typing", "all_keys"};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static double run(task_t task, int workload)
+{
+    const matrix_row_t all = (matrix_row_t)~(matrix_row_t)0 >> (sizeof(matrix_row_t) * 8 - MATRIX_COLS);
+    uint32_t random_state = 0x9e3779b9;
+    double best = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            matrix[row] = matrix_previous[row] = 0;
+        }
+        uint64_t start = now_ns();
+        for (uint32_t scan = 0; scan < SCANS; scan++) {
+            if (workload == TYPING && (scan & 15) == 0) {
+                random_state = random_state * 1664525 + 1013904223;
+                matrix[(random_state >> 8) % MATRIX_ROWS] ^= (matrix_row_t)1 << ((random_state >> 16) % MATRIX_COLS);
+            } else if (workload == ALL_KEYS) {
+                for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+                    matrix[row] ^= all;
+                }
+            }
+            task();
+        }
+        double ns = (double)(now_ns() - start) / SCANS;
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(void)
+{
+    printf("%dx%d, %d bit rows, ns per scan\n", MATRIX_ROWS, MATRIX_COLS, (int)sizeof(matrix_row_t) * 8);
+    printf("%-12s", "");
+    for (int workload = 0; workload < WORKLOADS; workload++) {
+        printf("%10s", workloads[workload]);
+    }
+    printf("\n");
+
+    for (unsigned i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        uint32_t expected = 0;
+        printf("%-12s", tasks[i].name);
+        for (int workload = 0; workload < WORKLOADS; workload++) {
+            events = 0;
+            printf("%10.2f", run(tasks[i].task, workload));
+            expected += events;
+        }
+        printf("\n");
+        // every loop has to see the same key events
+        static uint32_t first;
+        if (i == 0) {
+            first = expected;
+        } else if (expected != first) {
+            printf("%s saw other key events\n", tasks[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}
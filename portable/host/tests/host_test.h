@@ -0,0 +1,62 @@
+/**
+ * @file host_test.h
+ * @author astro
+ *  checks and main loop drivers shared by the host tests, see tests.mk
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_platform.h"
+#include "qmk_driver.h"
+#include "usb_common.h"
+
+#define HOST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+// run the main loop for ms milliseconds of simulated time, once per millisecond
+static inline void host_test_run_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        qmk_driver_task();
+        host_time_advance_us(1000);
+    }
+}
+
+// start the firmware on a fresh platform and let the startup reports pass
+static inline void host_test_boot(void)
+{
+    host_platform_init();
+    qmk_driver_init();
+    host_test_run_ms(100);
+    host_report_clear();
+}
+
+// the latest keyboard report captured, NULL if there is none
+static inline const report_keyboard_t *host_test_keyboard_report(void)
+{
+    for (uint32_t i = host_report_count(); i-- > 0;) {
+        const host_report_t *report = host_report_get(i);
+        if (report->type == HID_REPORT_ID_KEYBOARD) {
+            return (const report_keyboard_t *)report->data;
+        }
+    }
+    return NULL;
+}
+
+static inline bool host_test_report_has_key(const report_keyboard_t *report, uint8_t code)
+{
+    for (int i = 0; report && i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file config.h
+ * @author astro
+ *  keyboard of the host tests, see tests.mk
+ *
+ * A 6x16 matrix. The rows sit on two ports at different bit offsets, one
+ * of them away from the rest, so the port scan has to form several
+ * groups. The tests pick their features through the defines of tests.mk.
+ */
+
+#pragma once
+
+#include "amk_gpio.h"
+
+#define MATRIX_ROWS 6
+#define MATRIX_COLS 16
+
+#define MATRIX_ROW_PINS { HOST_PIN(0, 4), HOST_PIN(0, 5), HOST_PIN(0, 6), HOST_PIN(1, 0), HOST_PIN(1, 1), HOST_PIN(0, 12) }
+#define MATRIX_COL_PINS { HOST_PIN(2, 0), HOST_PIN(2, 1), HOST_PIN(2, 2), HOST_PIN(2, 3), HOST_PIN(2, 4), HOST_PIN(2, 5), HOST_PIN(2, 6), HOST_PIN(2, 7), HOST_PIN(2, 8), HOST_PIN(2, 9), HOST_PIN(2, 10), HOST_PIN(2, 11), HOST_PIN(2, 12), HOST_PIN(2, 13), HOST_PIN(2, 14), HOST_PIN(2, 15) }
+
+#define DEBOUNCE 5
+
+#define TOTAL_EEPROM_BYTE_COUNT 4096
+#define DYNAMIC_KEYMAP_LAYER_COUNT 2
+
+// the scans print every change otherwise
+#define MATRIX_SCAN_DEBUG 0
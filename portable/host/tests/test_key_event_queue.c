@@ -0,0 +1,117 @@
+/**
+ * @file test_key_event_queue.c
+ * @author astro
+ *  two thread stress of the key event queue, see key_event_queue.h
+ *
+ * A scan thread toggles bursts of random keys and calls
+ * keyboard_scan_task() until their debounced changes are all queued, while
+ * the main thread runs keyboard_task(). A burst is larger than the ring,
+ * so it overflows and the changes wait in the matrix. Every edge has to
+ * reach process_record_user() once and in scan order.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "key_event_queue.h"
+#include "action.h"
+
+#ifndef KEY_EVENT_QUEUE_SIZE
+#   define KEY_EVENT_QUEUE_SIZE 32
+#endif
+
+#define STEPS 5000
+#define BURST 16
+
+typedef struct {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+} edge_t;
+
+static edge_t expected[STEPS * BURST];
+static uint32_t expected_count;
+static edge_t seen[STEPS * BURST];
+static uint32_t seen_count;
+static bool scanning = true;
+
+// the edges end here, nothing has to reach the host
+bool process_record_user(uint16_t keycode, keyrecord_t *record)
+{
+    if (seen_count < STEPS * BURST) {
+        seen[seen_count].row = record->event.key.row;
+        seen[seen_count].col = record->event.key.col;
+        seen[seen_count].pressed = record->event.pressed;
+    }
+    seen_count++;
+    return false;
+}
+
+static void *scan_thread(void *arg)
+{
+    static bool keys[MATRIX_ROWS][MATRIX_COLS];
+    uint32_t random_state = 0x9e3779b9;
+
+    for (int step = 0; step < STEPS; step++) {
+        bool toggled[MATRIX_ROWS][MATRIX_COLS] = {{false}};
+        for (int n = 0; n < BURST; n++) {
+            random_state = random_state * 1664525 + 1013904223;
+            uint8_t row = (random_state >> 8) % MATRIX_ROWS;
+            uint8_t col = (random_state >> 16) % MATRIX_COLS;
+            toggled[row][col] = !toggled[row][col];
+        }
+
+        // debounced together, then queued row by row, lowest column first
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                if (toggled[row][col]) {
+                    keys[row][col] = !keys[row][col];
+                    host_matrix_set_key(row, col, keys[row][col]);
+                    expected[expected_count].row = row;
+                    expected[expected_count].col = col;
+                    expected[expected_count].pressed = keys[row][col];
+                    expected_count++;
+                }
+            }
+        }
+
+        // past the debounce, the scan reports a change while any is pending
+        uint64_t start = host_time_us();
+        while (keyboard_scan_task() || host_time_us() - start < (DEBOUNCE + 2) * 1000) {
+            host_time_advance_us(1000);
+            sched_yield();
+        }
+    }
+
+    __atomic_store_n(&scanning, false, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    pthread_t scanner;
+    HOST_CHECK(pthread_create(&scanner, NULL, scan_thread, NULL) == 0);
+    while (__atomic_load_n(&scanning, __ATOMIC_ACQUIRE)) {
+        qmk_driver_task();
+        sched_yield();
+    }
+    pthread_join(scanner, NULL);
+    // what the last scan queued
+    qmk_driver_task();
+
+    HOST_CHECK(seen_count == expected_count);
+    for (uint32_t i = 0; i < expected_count; i++) {
+        HOST_CHECK(seen[i].row == expected[i].row);
+        HOST_CHECK(seen[i].col == expected[i].col);
+        HOST_CHECK(seen[i].pressed == expected[i].pressed);
+    }
+    HOST_CHECK(key_event_queue_overflows() > 0);
+    HOST_CHECK(key_event_queue_high_water() == KEY_EVENT_QUEUE_SIZE);
+
+    printf("key event queue: %lu edges in order, %lu overflows\n", (unsigned long)expected_count, (unsigned long)key_event_queue_overflows());
+    return 0;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file test_keypress.c
+ * @author astro
+ *  one key through scan, debounce, action and host driver
+ */
+
+#include "host_test.h"
+
+int main(void)
+{
+    host_test_boot();
+
+    // KC_1 at row 0, column 1 of the test keymap
+    uint64_t pressed = host_time_us();
+    host_matrix_set_key(0, 1, true);
+    host_test_run_ms(20);
+
+    const report_keyboard_t *report = host_test_keyboard_report();
+    HOST_CHECK(report != NULL);
+    HOST_CHECK(host_test_report_has_key(report, KC_1));
+    HOST_CHECK(host_report_get(0)->time_us - pressed <= (DEBOUNCE + 2) * 1000);
+
+    host_matrix_set_key(0, 1, false);
+    host_test_run_ms(20);
+
+    report = host_test_keyboard_report();
+    HOST_CHECK(!host_test_report_has_key(report, KC_1));
+    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        HOST_CHECK(report->keys[i] == KC_NO);
+    }
+
+    printf("keypress: %lu reports\n", (unsigned long)host_report_count());
+    return 0;
+}
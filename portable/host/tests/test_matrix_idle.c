@@ -0,0 +1,74 @@
+/**
+ * @file test_matrix_idle.c
+ * @author astro
+ *  idle and active transitions of the matrix scanner, see matrix_scan.h
+ */
+
+#include "host_test.h"
+#include "matrix.h"
+#include "matrix_scan.h"
+
+static matrix_row_t raw[MATRIX_ROWS];
+
+static void scan_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        matrix_scan_custom(raw);
+        host_time_advance_us(1000);
+    }
+}
+
+int main(void)
+{
+    host_platform_init();
+    matrix_init_custom();
+
+    // idle only once released for the whole timeout
+    scan_ms(MATRIX_IDLE_TIMEOUT / 2);
+    HOST_CHECK(!matrix_is_idle());
+    scan_ms(MATRIX_IDLE_TIMEOUT);
+    HOST_CHECK(matrix_is_idle());
+
+    // an idle scan neither drives the columns nor waits for them
+    uint64_t now = host_time_us();
+    HOST_CHECK(!matrix_scan_custom(raw));
+    HOST_CHECK(host_time_us() == now);
+
+    // a press wakes the scanner and shows up in the next scan
+    host_matrix_set_key(2, 3, true);
+#ifndef MATRIX_IDLE_POLL
+    HOST_CHECK(host_gpio_wakeups() == 1);
+#endif
+    HOST_CHECK(matrix_scan_custom(raw));
+    HOST_CHECK(!matrix_is_idle());
+    HOST_CHECK(raw[2] == (matrix_row_t)1 << 3);
+
+    // a held key keeps it scanning
+    scan_ms(MATRIX_IDLE_TIMEOUT * 3);
+    HOST_CHECK(!matrix_is_idle());
+
+    // idle again a timeout after the release
+    host_matrix_set_key(2, 3, false);
+    scan_ms(1);
+    HOST_CHECK(raw[2] == 0);
+    HOST_CHECK(!matrix_is_idle());
+    scan_ms(MATRIX_IDLE_TIMEOUT + 1);
+    HOST_CHECK(matrix_is_idle());
+
+    // a wakeup without a key goes straight back to idle
+    matrix_wakeup_signal();
+    HOST_CHECK(!matrix_scan_custom(raw));
+    HOST_CHECK(matrix_is_idle());
+
+    // a key of another port wakes it as well, the columns stay released
+    host_matrix_set_key(5, 15, true);
+    scan_ms(1);
+    HOST_CHECK(!matrix_is_idle());
+    HOST_CHECK(raw[5] == (matrix_row_t)1 << 15);
+    for (uint8_t row = 0; row < 5; row++) {
+        HOST_CHECK(raw[row] == 0);
+    }
+
+    printf("matrix idle: %lu wakeups\n", (unsigned long)host_gpio_wakeups());
+    return 0;
+}
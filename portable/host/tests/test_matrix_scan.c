@@ -0,0 +1,61 @@
+/**
+ * @file test_matrix_scan.c
+ * @author astro
+ *  raw matrix of portable/matrix_scan.c against the simulated key switches
+ *
+ * Toggles random keys, scans once per step and compares raw[] with the
+ * keys set on the gpio model. The digest of every raw[] seen is printed,
+ * tests.mk compares it between the scan configurations.
+ */
+
+#include "host_test.h"
+#include "matrix.h"
+
+#define STEPS 2000
+
+static uint32_t random_state = 0x12345678;
+
+static uint32_t random_next(void)
+{
+    random_state = random_state * 1664525 + 1013904223;
+    return random_state >> 8;
+}
+
+int main(void)
+{
+    static bool keys[MATRIX_ROWS][MATRIX_COLS];
+    matrix_row_t raw[MATRIX_ROWS] = {0};
+    uint32_t digest = 2166136261u;
+
+    host_platform_init();
+    matrix_init_custom();
+
+    for (int step = 0; step < STEPS; step++) {
+        for (uint32_t n = random_next() % 3 + 1; n > 0; n--) {
+            uint8_t row = random_next() % MATRIX_ROWS;
+            uint8_t col = random_next() % MATRIX_COLS;
+            keys[row][col] = !keys[row][col];
+            host_matrix_set_key(row, col, keys[row][col]);
+        }
+
+        matrix_scan_custom(raw);
+        host_time_advance_us(1000);
+
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            matrix_row_t expected = 0;
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                if (keys[row][col]) {
+                    expected |= (matrix_row_t)1 << col;
+                }
+            }
+            HOST_CHECK(raw[row] == expected);
+
+            for (size_t i = 0; i < sizeof(matrix_row_t); i++) {
+                digest = (digest ^ (uint8_t)(raw[row] >> (i * 8))) * 16777619u;
+            }
+        }
+    }
+
+    printf("matrix scan: %d steps, raw digest %08lx\n", STEPS, (unsigned long)digest);
+    return 0;
+}
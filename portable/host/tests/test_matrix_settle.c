@@ -0,0 +1,125 @@
+/**
+ * @file test_matrix_settle.c
+ * @author astro
+ *  settle time calibration of portable/matrix_scan.c on the row inputs
+ */
+
+#include "host_test.h"
+#include "matrix.h"
+#include "matrix_scan.h"
+
+#ifndef MATRIX_SETTLE_US
+#   define MATRIX_SETTLE_US 10
+#endif
+#ifndef MATRIX_SETTLE_MARGIN_US
+#   define MATRIX_SETTLE_MARGIN_US 1
+#endif
+#ifndef MATRIX_SETTLE_SAMPLES
+#   define MATRIX_SETTLE_SAMPLES 8
+#endif
+
+static matrix_row_t raw[MATRIX_ROWS];
+static bool keys[MATRIX_ROWS][MATRIX_COLS];
+static uint32_t random_state = 0x2468ace0;
+
+static uint32_t random_next(void)
+{
+    random_state = random_state * 1664525 + 1013904223;
+    return random_state >> 8;
+}
+
+// settle time of the columns on the gpio model
+static uint8_t column_settle(uint8_t col)
+{
+    return col % 5;
+}
+
+static void scan(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        matrix_scan_custom(raw);
+        host_time_advance_us(1000);
+    }
+}
+
+static void set_key(uint8_t row, uint8_t col, bool pressed)
+{
+    keys[row][col] = pressed;
+    host_matrix_set_key(row, col, pressed);
+}
+
+static void check_raw(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t expected = 0;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            if (keys[row][col]) {
+                expected |= (matrix_row_t)1 << col;
+            }
+        }
+        HOST_CHECK(raw[row] == expected);
+    }
+}
+
+int main(void)
+{
+    host_platform_init();
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        host_matrix_set_settle_us(col, column_settle(col));
+    }
+    matrix_init_custom();
+
+    // released rows cannot be timed, every column waits the full time
+    scan(10);
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        HOST_CHECK(matrix_settle_time(col) == MATRIX_SETTLE_US);
+    }
+
+    // a held key measures its column on the rows
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        uint8_t row = col % MATRIX_ROWS;
+        set_key(row, col, true);
+        scan(MATRIX_SETTLE_SAMPLES);
+        check_raw();
+        HOST_CHECK(matrix_settle_time(col) == column_settle(col) + MATRIX_SETTLE_MARGIN_US);
+        set_key(row, col, false);
+        scan(1);
+        check_raw();
+    }
+
+    // every change is seen on the next scan with the measured times
+    for (int step = 0; step < 2000; step++) {
+        uint8_t row = random_next() % MATRIX_ROWS;
+        uint8_t col = random_next() % MATRIX_COLS;
+        set_key(row, col, !keys[row][col]);
+        scan(1);
+        check_raw();
+    }
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        HOST_CHECK(matrix_settle_time(col) == column_settle(col) + MATRIX_SETTLE_MARGIN_US);
+    }
+
+    // a column slowing down reads released until its verification comes
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            set_key(row, col, false);
+        }
+    }
+    scan(1);
+    host_matrix_set_settle_us(3, MATRIX_SETTLE_US - 2);
+    set_key(1, 3, true);
+    int scans = 0;
+    while (!(raw[1] & (1 << 3))) {
+        HOST_CHECK(++scans <= MATRIX_COLS);
+        scan(1);
+    }
+    HOST_CHECK(matrix_settle_time(3) == MATRIX_SETTLE_US);
+
+    // and is measured again while the key is held
+    scan(MATRIX_SETTLE_SAMPLES);
+    check_raw();
+    HOST_CHECK(matrix_settle_time(3) == MATRIX_SETTLE_US - 2 + MATRIX_SETTLE_MARGIN_US);
+
+    printf("matrix settle: slow column caught after %d scans\n", scans);
+    return 0;
+}
@@ -0,0 +1,112 @@
+# Host tests and benchmarks, included by qmk_host.mk
+#
+# Every program is built against a libqmk_host.a of its own, in
+# $(HOST_BUILD_DIR)/<name>, for the keyboard of keyboard/. Per program:
+#
+#   <name>_SRC         source without .c, <name> by default, for programs
+#                      built in several configurations
+#   <name>_DEFS        defines of its library build
+#   <name>_MAKE        make variables of its library build, e.g. features
+#   <name>_ARGS        its arguments
+#   <name>_SAME_AS     the test whose output it has to repeat byte for byte
+#   <name>_STANDALONE  yes for a program which links no library and so
+#                      builds without the vial-qmk submodule
+#
+# test-<name> builds and runs one program, test all of HOST_TESTS and
+# bench all of HOST_BENCHES. A program fails with a non zero exit status,
+# its output is kept in $(HOST_BUILD_DIR)/<name>/output.txt.
+
+HOST_TESTS :=
+HOST_BENCHES :=
+
+# a key press through the whole firmware, the smoke test of the build
+HOST_TESTS += keypress
+keypress_SRC := test_keypress
+
+# the port scan has to give the raw matrix of the pin scan bit for bit
+HOST_TESTS += matrix_pin matrix_port
+matrix_pin_SRC := test_matrix_scan
+matrix_port_SRC := test_matrix_scan
+matrix_port_DEFS := -DMATRIX_PORT_SCAN_ENABLE
+matrix_port_SAME_AS := matrix_pin
+test-matrix_port: test-matrix_pin
+
+# the settle times measured on the rows, and the raw matrix they give
+HOST_TESTS += matrix_settle matrix_calibrate
+matrix_settle_SRC := test_matrix_settle
+matrix_settle_DEFS := -DMATRIX_SETTLE_CALIBRATE
+matrix_calibrate_SRC := test_matrix_scan
+matrix_calibrate_DEFS := -DMATRIX_SETTLE_CALIBRATE
+matrix_calibrate_SAME_AS := matrix_pin
+test-matrix_calibrate: test-matrix_pin
+
+# the key event ring between a scan thread and keyboard_task()
+HOST_TESTS += key_event_queue
+key_event_queue_SRC := test_key_event_queue
+key_event_queue_DEFS := -DKEY_EVENT_QUEUE_ENABLE -DKEY_EVENT_QUEUE_EXTERNAL_SCAN -DKEY_EVENT_QUEUE_SIZE=4
+
+# idle scanning on the edge wakeups of the gpio model, and polled
+HOST_TESTS += matrix_idle matrix_idle_poll
+matrix_idle_SRC := test_matrix_idle
+matrix_idle_DEFS := -DMATRIX_IDLE_TIMEOUT=20
+matrix_idle_poll_SRC := test_matrix_idle
+matrix_idle_poll_DEFS := -DMATRIX_IDLE_TIMEOUT=20 -DMATRIX_IDLE_POLL
+
+# the change detection of matrix_task() over several matrix geometries
+HOST_BENCHES += matrix_diff_5x14 matrix_diff_6x21 matrix_diff_8x18 matrix_diff_12x8 matrix_diff_4x40
+$(foreach g,5x14 6x21 8x18 12x8 4x40,$(eval matrix_diff_$(g)_SRC := bench_matrix_diff))
+$(foreach g,5x14 6x21 8x18 12x8 4x40,$(eval matrix_diff_$(g)_STANDALONE := yes))
+matrix_diff_5x14_DEFS := -DMATRIX_ROWS=5 -DMATRIX_COLS=14
+matrix_diff_6x21_DEFS := -DMATRIX_ROWS=6 -DMATRIX_COLS=21
+matrix_diff_8x18_DEFS := -DMATRIX_ROWS=8 -DMATRIX_COLS=18
+matrix_diff_12x8_DEFS := -DMATRIX_ROWS=12 -DMATRIX_COLS=8
+matrix_diff_4x40_DEFS := -DMATRIX_ROWS=4 -DMATRIX_COLS=40
+
+# a typing trace through the whole firmware, per feature of GENERIC_FEATURES
+HOST_BENCHES += keystroke_base keystroke_combo keystroke_tap_dance keystroke_key_override keystroke_caps_word keystroke_all
+$(foreach f,base combo tap_dance key_override caps_word all,$(eval keystroke_$(f)_SRC := bench_keystroke_cost))
+$(foreach f,base combo tap_dance key_override caps_word all,$(eval keystroke_$(f)_ARGS := $(HOST_TEST_DIR)/traces/prose.trace))
+keystroke_combo_MAKE := COMBO_ENABLE=yes
+keystroke_tap_dance_MAKE := TAP_DANCE_ENABLE=yes
+keystroke_key_override_MAKE := KEY_OVERRIDE_ENABLE=yes
+keystroke_caps_word_MAKE := CAPS_WORD_ENABLE=yes
+keystroke_all_MAKE := COMBO_ENABLE=yes TAP_DANCE_ENABLE=yes KEY_OVERRIDE_ENABLE=yes CAPS_WORD_ENABLE=yes
+
+# a whole keymap through the eeprom model, per write strategy
+HOST_BENCHES += eeprom_keymap
+eeprom_keymap_SRC := bench_eeprom_keymap
+
+# flash erases of the log store against writing the eeprom in place
+HOST_BENCHES += log_store
+log_store_SRC := bench_log_store
+log_store_MAKE := LOG_STORE_ENABLE=yes
+
+QMK_HOST_MK := $(firstword $(MAKEFILE_LIST))
+
+.PHONY: test bench host_test FORCE
+test: $(addprefix test-,$(HOST_TESTS))
+bench: $(addprefix test-,$(HOST_BENCHES))
+
+# not phony, make searches no pattern rules for phony targets
+test-%: FORCE
+	$(MAKE) -f $(QMK_HOST_MK) KEYBOARD_DIR=$(HOST_TEST_KEYBOARD) HOST_BUILD_DIR=$(HOST_BUILD_DIR)/$* \
+		HOST_TEST_SRC=$(or $($*_SRC),$*) HOST_TEST_STANDALONE=$($*_STANDALONE) HOST_DEFS='$($*_DEFS)' $($*_MAKE) host_test
+	$(HOST_BUILD_DIR)/$*/$(or $($*_SRC),$*) $($*_ARGS) > $(HOST_BUILD_DIR)/$*/output.txt; \
+		status=$$?; cat $(HOST_BUILD_DIR)/$*/output.txt; exit $$status
+	$(if $($*_SAME_AS),cmp $(HOST_BUILD_DIR)/$*/output.txt $(HOST_BUILD_DIR)/$($*_SAME_AS)/output.txt)
+
+FORCE:
+
+ifneq ($(strip $(HOST_TEST_SRC)),)
+HOST_TEST_PROGRAM := $(HOST_BUILD_DIR)/$(HOST_TEST_SRC)
+
+host_test: $(HOST_TEST_PROGRAM)
+
+ifeq ($(strip $(HOST_TEST_STANDALONE)), yes)
+$(HOST_TEST_PROGRAM): $(HOST_TEST_DIR)/$(HOST_TEST_SRC).c | $(HOST_BUILD_DIR)
+	$(HOST_CC) $(HOST_CFLAGS) $(HOST_DEFS) -I$(HOST_TEST_DIR) $< -o $@
+else
+$(HOST_TEST_PROGRAM): $(HOST_TEST_DIR)/$(HOST_TEST_SRC).c $(HOST_BUILD_DIR)/libqmk_host.a
+	$(HOST_CC) $(HOST_CFLAGS) $(APP_DEFS) $(addprefix -I,$(INCS) $(HOST_TEST_DIR)) $< $(HOST_BUILD_DIR)/libqmk_host.a -lpthread -o $@
+endif
+endif
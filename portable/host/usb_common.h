@@ -0,0 +1,24 @@
+/**
+ * @file usb_common.h
+ * @author astro
+ *  host stand-in for the usb report ids, see qmk_host.mk
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+    HID_REPORT_ID_KEYBOARD = 1,
+    HID_REPORT_ID_MOUSE,
+    HID_REPORT_ID_SYSTEM,
+    HID_REPORT_ID_CONSUMER,
+    HID_REPORT_ID_NKRO,
+    HID_REPORT_ID_VIAL,
+    HID_REPORT_ID_DELAY,
+    HID_REPORT_ID_MACRO_BEGIN,
+    HID_REPORT_ID_MACRO_END,
+    HID_REPORT_ID_UNKNOWN,
+};
@@ -0,0 +1,12 @@
+/**
+ * @file usb_interface.h
+ * @author astro
+ *  host stand-in for the usb interface, see qmk_host.mk
+ */
+
+#pragma once
+
+#include "usb_common.h"
+
+/* captured into the report log of host_platform.h */
+void usb_send_report(uint8_t report_type, const void *data, size_t size);
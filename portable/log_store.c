@@ -0,0 +1,327 @@
+/**
+ * @file log_store.c
+ * @author astro
+ *  append only record store on two flash banks, see log_store.h
+ *
+ * Bank layout: a header with magic and sequence number, then records of
+ * block number, check and block data back to back up to the first erased
+ * record. The bank with a valid header and the newest sequence is the
+ * active one. A compaction writes the header of the new bank last, so an
+ * interrupted compaction leaves the old bank active.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "log_store.h"
+#include "timer.h"
+
+#define LOG_STORE_BLOCKS ((LOG_STORE_SIZE + LOG_STORE_BLOCK_SIZE - 1) / LOG_STORE_BLOCK_SIZE)
+#define LOG_STORE_MAGIC 0x4B4D4C53
+#define LOG_STORE_HEADER_SIZE sizeof(log_store_header_t)
+#define LOG_STORE_RECORD_SIZE sizeof(log_store_record_t)
+#define LOG_STORE_NONE 0
+#define LOG_STORE_SLOT_FREE 0xFFFF
+
+#if LOG_STORE_BLOCK_SIZE % 4
+#   error LOG_STORE_BLOCK_SIZE must be a multiple of 4
+#endif
+
+#if LOG_STORE_BANK_SIZE > 65536
+#   error LOG_STORE_BANK_SIZE must be 64K or less
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+} log_store_header_t;
+
+typedef struct {
+    uint16_t block;
+    uint16_t check;
+    uint8_t data[LOG_STORE_BLOCK_SIZE];
+} log_store_record_t;
+
+typedef struct {
+    uint16_t block;
+    bool dirty;
+    uint32_t used;
+    uint8_t data[LOG_STORE_BLOCK_SIZE];
+} log_store_slot_t;
+
+// a compacted bank must hold every block and still take the whole cache
+_Static_assert(LOG_STORE_HEADER_SIZE + (LOG_STORE_BLOCKS + LOG_STORE_CACHE_BLOCKS) * LOG_STORE_RECORD_SIZE <= LOG_STORE_BANK_SIZE,
+               "LOG_STORE_BANK_SIZE is too small for LOG_STORE_SIZE");
+
+// offset of the latest record of every block in the active bank
+static uint16_t record_index[LOG_STORE_BLOCKS];
+static log_store_slot_t slots[LOG_STORE_CACHE_BLOCKS];
+static uint32_t slot_clock;
+static bool mounted;
+static bool dirty;
+static uint32_t last_write;
+static uint8_t active_bank;
+static uint32_t sequence;
+static uint32_t append_offset;
+
+__attribute__((weak))
+void log_store_backing_read(uint16_t offset, void *data, uint16_t size)
+{
+    memset(data, 0xFF, size);
+}
+
+static uint16_t record_check(const log_store_record_t *record)
+{
+    // fletcher-16 over the block number and the data
+    uint8_t block[2] = {record->block & 0xFF, record->block >> 8};
+    uint16_t a = 0;
+    uint16_t b = 0;
+    for (uint16_t i = 0; i < sizeof(block); i++) {
+        a = (a + block[i]) % 255;
+        b = (b + a) % 255;
+    }
+    for (uint16_t i = 0; i < LOG_STORE_BLOCK_SIZE; i++) {
+        a = (a + record->data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+static bool record_erased(const log_store_record_t *record)
+{
+    const uint8_t *p = (const uint8_t *)record;
+    for (uint16_t i = 0; i < LOG_STORE_RECORD_SIZE; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bank_start(uint8_t bank)
+{
+    log_store_header_t header = {LOG_STORE_MAGIC, sequence};
+    log_store_flash_program(bank, 0, &header, sizeof(header));
+    active_bank = bank;
+}
+
+static void log_store_mount(void)
+{
+    log_store_header_t headers[2];
+    bool valid[2];
+    for (uint8_t bank = 0; bank < 2; bank++) {
+        log_store_flash_read(bank, 0, &headers[bank], sizeof(headers[bank]));
+        valid[bank] = headers[bank].magic == LOG_STORE_MAGIC;
+    }
+
+    memset(record_index, 0, sizeof(record_index));
+    for (uint8_t i = 0; i < LOG_STORE_CACHE_BLOCKS; i++) {
+        slots[i].block = LOG_STORE_SLOT_FREE;
+        slots[i].dirty = false;
+    }
+    dirty = false;
+    mounted = true;
+
+    if (!valid[0] && !valid[1]) {
+        log_store_flash_erase(0);
+        sequence = 1;
+        bank_start(0);
+        append_offset = LOG_STORE_HEADER_SIZE;
+        return;
+    }
+
+    if (valid[0] && valid[1]) {
+        active_bank = (int32_t)(headers[1].sequence - headers[0].sequence) > 0 ? 1 : 0;
+    } else {
+        active_bank = valid[1] ? 1 : 0;
+    }
+    sequence = headers[active_bank].sequence;
+
+    // a torn record fails its check and is skipped, the log goes on after it
+    uint32_t offset = LOG_STORE_HEADER_SIZE;
+    for (; offset + LOG_STORE_RECORD_SIZE <= LOG_STORE_BANK_SIZE; offset += LOG_STORE_RECORD_SIZE) {
+        log_store_record_t record;
+        log_store_flash_read(active_bank, offset, &record, sizeof(record));
+        if (record_erased(&record)) {
+            break;
+        }
+        if (record.block < LOG_STORE_BLOCKS && record.check == record_check(&record)) {
+            record_index[record.block] = offset;
+        }
+    }
+    append_offset = offset;
+}
+
+// copy the latest record of every block into the other bank
+static void log_store_compact(void)
+{
+    uint8_t target = active_bank ^ 1;
+    uint32_t offset = LOG_STORE_HEADER_SIZE;
+    log_store_flash_erase(target);
+    for (uint16_t block = 0; block < LOG_STORE_BLOCKS; block++) {
+        if (record_index[block] == LOG_STORE_NONE) {
+            continue;
+        }
+        log_store_record_t record;
+        log_store_flash_read(active_bank, record_index[block], &record, sizeof(record));
+        log_store_flash_program(target, offset, &record, sizeof(record));
+        record_index[block] = offset;
+        offset += LOG_STORE_RECORD_SIZE;
+    }
+    sequence++;
+    bank_start(target);
+    append_offset = offset;
+}
+
+static void slot_write_back(log_store_slot_t *slot)
+{
+    if (append_offset + LOG_STORE_RECORD_SIZE > LOG_STORE_BANK_SIZE) {
+        log_store_compact();
+    }
+
+    log_store_record_t record;
+    record.block = slot->block;
+    memcpy(record.data, slot->data, sizeof(record.data));
+    record.check = record_check(&record);
+    log_store_flash_program(active_bank, append_offset, &record, sizeof(record));
+    record_index[slot->block] = append_offset;
+    append_offset += LOG_STORE_RECORD_SIZE;
+    slot->dirty = false;
+}
+
+// read part of a block which is not in the cache
+static void block_read(uint16_t block, uint16_t start, void *data, uint16_t size)
+{
+    if (record_index[block] != LOG_STORE_NONE) {
+        log_store_flash_read(active_bank, record_index[block] + offsetof(log_store_record_t, data) + start, data, size);
+        return;
+    }
+
+    uint16_t offset = block * LOG_STORE_BLOCK_SIZE + start;
+    uint16_t backed = offset < LOG_STORE_SIZE ? LOG_STORE_SIZE - offset : 0;
+    if (backed > size) {
+        backed = size;
+    }
+    log_store_backing_read(offset, data, backed);
+    memset((uint8_t *)data + backed, 0xFF, size - backed);
+}
+
+static log_store_slot_t *slot_find(uint16_t block)
+{
+    for (uint8_t i = 0; i < LOG_STORE_CACHE_BLOCKS; i++) {
+        if (slots[i].block == block) {
+            slots[i].used = ++slot_clock;
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+// least recently used slot, clean ones first
+static log_store_slot_t *slot_get(uint16_t block)
+{
+    log_store_slot_t *slot = slot_find(block);
+    if (slot) {
+        return slot;
+    }
+
+    for (uint8_t i = 0; i < LOG_STORE_CACHE_BLOCKS; i++) {
+        log_store_slot_t *candidate = &slots[i];
+        if (!slot || (candidate->dirty == slot->dirty ? candidate->used < slot->used : !candidate->dirty)) {
+            slot = candidate;
+        }
+    }
+    if (slot->dirty) {
+        slot_write_back(slot);
+    }
+
+    slot->block = block;
+    slot->used = ++slot_clock;
+    block_read(block, 0, slot->data, LOG_STORE_BLOCK_SIZE);
+    return slot;
+}
+
+void log_store_read(uint16_t offset, void *data, uint16_t size)
+{
+    if (!mounted) {
+        log_store_mount();
+    }
+
+    uint8_t *target = data;
+    while (size) {
+        uint16_t block = offset / LOG_STORE_BLOCK_SIZE;
+        uint16_t start = offset % LOG_STORE_BLOCK_SIZE;
+        uint16_t part = LOG_STORE_BLOCK_SIZE - start;
+        if (part > size) {
+            part = size;
+        }
+
+        if (block >= LOG_STORE_BLOCKS) {
+            memset(target, 0xFF, size);
+            return;
+        }
+
+        log_store_slot_t *slot = slot_find(block);
+        if (slot) {
+            memcpy(target, &slot->data[start], part);
+        } else {
+            block_read(block, start, target, part);
+        }
+        offset += part;
+        target += part;
+        size -= part;
+    }
+}
+
+void log_store_write(uint16_t offset, const void *data, uint16_t size)
+{
+    if (!mounted) {
+        log_store_mount();
+    }
+
+    const uint8_t *source = data;
+    while (size) {
+        uint16_t block = offset / LOG_STORE_BLOCK_SIZE;
+        uint16_t start = offset % LOG_STORE_BLOCK_SIZE;
+        uint16_t part = LOG_STORE_BLOCK_SIZE - start;
+        if (part > size) {
+            part = size;
+        }
+
+        if (block >= LOG_STORE_BLOCKS) {
+            return;
+        }
+
+        log_store_slot_t *slot = slot_get(block);
+        if (memcmp(&slot->data[start], source, part)) {
+            memcpy(&slot->data[start], source, part);
+            slot->dirty = true;
+            dirty = true;
+            last_write = timer_read32();
+        }
+        offset += part;
+        source += part;
+        size -= part;
+    }
+}
+
+void log_store_flush(void)
+{
+    if (!dirty) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < LOG_STORE_CACHE_BLOCKS; i++) {
+        if (slots[i].dirty) {
+            slot_write_back(&slots[i]);
+        }
+    }
+    dirty = false;
+}
+
+void log_store_task(void)
+{
+    if (dirty && timer_elapsed32(last_write) >= LOG_STORE_FLUSH_DELAY) {
+        log_store_flush();
+    }
+}
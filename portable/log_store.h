@@ -0,0 +1,63 @@
+/**
+ * @file log_store.h
+ * @author astro
+ *  append only record store on two flash banks, for the dynamic keymap
+ *
+ * The logical space of LOG_STORE_SIZE bytes is split into blocks of
+ * LOG_STORE_BLOCK_SIZE. A write never rewrites flash in place, the new
+ * contents of a block are appended to the active bank as a record and a
+ * RAM index points to the latest record of every block. When the bank is
+ * full the latest records are copied to the other bank, which then becomes
+ * the active one, so a bank is only erased once per compaction.
+ *
+ * Writes are coalesced in a small write back cache and flushed from
+ * log_store_task() once no write came for LOG_STORE_FLUSH_DELAY ms. Call
+ * log_store_flush() before anything which may lose power. clear_keyboard()
+ * of protocol/action.c does so for the QMK resets and raw_hid_send() of
+ * qmk_driver.c for the via bootloader jump.
+ *
+ * Blocks never written are read through log_store_backing_read(), so the
+ * data of a former in place store carries over.
+ *
+ * Enabled with LOG_STORE_ENABLE = yes, the platform provides the
+ * log_store_flash_* functions.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef LOG_STORE_SIZE
+#   define LOG_STORE_SIZE TOTAL_EEPROM_BYTE_COUNT
+#endif
+
+#ifndef LOG_STORE_BLOCK_SIZE
+#   define LOG_STORE_BLOCK_SIZE 32
+#endif
+
+#ifndef LOG_STORE_BANK_SIZE
+#   define LOG_STORE_BANK_SIZE 8192
+#endif
+
+#ifndef LOG_STORE_CACHE_BLOCKS
+#   define LOG_STORE_CACHE_BLOCKS 4
+#endif
+
+#ifndef LOG_STORE_FLUSH_DELAY
+#   define LOG_STORE_FLUSH_DELAY 1000
+#endif
+
+void log_store_read(uint16_t offset, void *data, uint16_t size);
+void log_store_write(uint16_t offset, const void *data, uint16_t size);
+/* write the dirty blocks once writing paused, call from the main loop */
+void log_store_task(void);
+void log_store_flush(void);
+
+/* read the data of blocks which have no record yet, erased by default */
+void log_store_backing_read(uint16_t offset, void *data, uint16_t size);
+
+/* flash of the two banks, erased flash reads 0xFF and program only clears bits */
+void log_store_flash_read(uint8_t bank, uint32_t offset, void *data, uint32_t size);
+void log_store_flash_program(uint8_t bank, uint32_t offset, const void *data, uint32_t size);
+void log_store_flash_erase(uint8_t bank);
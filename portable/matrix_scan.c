@@ -7,9 +7,11 @@
 #include <string.h>
 
 #include "matrix.h"
+#include "matrix_scan.h"
 #include "amk_gpio.h"
 #include "amk_printf.h"
 #include "wait.h"
+#include "timer.h"
 
 #ifndef MATRIX_SCAN_DEBUG
 #define MATRIX_SCAN_DEBUG 1
@@ -21,13 +23,317 @@
 #define matrix_scan_debug(...)
 #endif
 
-#ifndef DEBOUNCE
-#   define DEBOUNCE 5
+// microseconds to wait after driving a column, before reading the rows
+#ifndef MATRIX_SETTLE_US
+#   define MATRIX_SETTLE_US 10
+#endif
+
+// safety margin added to the calibrated settle time
+#ifndef MATRIX_SETTLE_MARGIN_US
+#   define MATRIX_SETTLE_MARGIN_US 1
+#endif
+
+// number of scans with a held key which measure the settle time of a column
+#ifndef MATRIX_SETTLE_SAMPLES
+#   define MATRIX_SETTLE_SAMPLES 8
+#endif
+
+// milliseconds of all released matrix before switching to idle scanning, 0 disables it
+#ifndef MATRIX_IDLE_TIMEOUT
+#   define MATRIX_IDLE_TIMEOUT 0
 #endif
 
 static pin_t col_pins[] = MATRIX_COL_PINS;
 static pin_t row_pins[] = MATRIX_ROW_PINS;
 
+// time of the scan which last changed each raw row
+static uint16_t row_times[MATRIX_ROWS];
+
+uint16_t matrix_get_row_time(uint8_t row)
+{
+    return row < MATRIX_ROWS ? row_times[row] : timer_read();
+}
+
+// the states of all the rows read with one column driven
+#if MATRIX_ROWS <= 32
+typedef uint32_t matrix_rows_t;
+#else
+typedef uint64_t matrix_rows_t;
+#endif
+
+#ifdef MATRIX_PORT_SCAN_ENABLE
+_Static_assert(MATRIX_ROWS <= 32, "the port scan moves the rows as 32 bit port values");
+
+/*
+ * Read the row pins one GPIO port at a time instead of pin by pin. The
+ * platform has to provide GPIO_PIN_PORT(pin), GPIO_PIN_BIT(pin) and
+ * gpio_read_port(port) through amk_gpio.h.
+ *
+ * Rows sharing a port and the same distance between their port bit and
+ * row index form a group, which is moved into place with a single shift
+ * and mask. With the rows wired to consecutive port bits this is one
+ * group per port.
+ */
+typedef struct {
+    uint8_t port;
+    int8_t shift;
+    uint32_t rows;
+} row_group_t;
+
+static uintptr_t row_ports[MATRIX_ROWS];
+static uint8_t row_port_count = 0;
+static row_group_t row_groups[MATRIX_ROWS];
+static uint8_t row_group_count = 0;
+
+static void matrix_init_row_groups(void)
+{
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        uintptr_t port = (uintptr_t)GPIO_PIN_PORT(row_pins[row]);
+        int8_t shift = (int8_t)GPIO_PIN_BIT(row_pins[row]) - row;
+
+        uint8_t p = 0;
+        while (p < row_port_count && row_ports[p] != port) p++;
+        if (p == row_port_count) {
+            row_ports[row_port_count++] = port;
+        }
+
+        uint8_t g = 0;
+        while (g < row_group_count && (row_groups[g].port != p || row_groups[g].shift != shift)) g++;
+        if (g == row_group_count) {
+            row_groups[row_group_count].port = p;
+            row_groups[row_group_count].shift = shift;
+            row_groups[row_group_count].rows = 0;
+            row_group_count++;
+        }
+        row_groups[g].rows |= 1UL << row;
+    }
+    matrix_scan_debug("matrix rows: %d ports, %d groups\n", row_port_count, row_group_count);
+}
+
+static matrix_rows_t matrix_read_rows(void)
+{
+    uint32_t values[MATRIX_ROWS];
+    for (uint8_t p = 0; p < row_port_count; p++) {
+        values[p] = gpio_read_port(row_ports[p]);
+    }
+
+    matrix_rows_t rows = 0;
+    for (uint8_t g = 0; g < row_group_count; g++) {
+        const row_group_t *group = &row_groups[g];
+        uint32_t value = values[group->port];
+        value = group->shift >= 0 ? value >> group->shift : value << -group->shift;
+        rows |= value & group->rows;
+    }
+    return rows;
+}
+#else
+static matrix_rows_t matrix_read_rows(void)
+{
+    matrix_rows_t rows = 0;
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        if (gpio_read_pin(row_pins[row])) {
+            rows |= (matrix_rows_t)1 << row;
+        }
+    }
+    return rows;
+}
+#endif
+
+#ifdef MATRIX_SETTLE_CALIBRATE
+/*
+ * Per column settle time, measured on the row inputs. With all the keys
+ * released the rows read low whatever the delay, so a column is only
+ * measured while one of its keys is held: MATRIX_SETTLE_SAMPLES scans time
+ * how long its rows take to read their settled value after the drive, and
+ * the longest time plus MATRIX_SETTLE_MARGIN_US becomes its settle time.
+ * Until then, and for a column never pressed, it stays MATRIX_SETTLE_US.
+ *
+ * Rows read after a shorter settle are verified against a read after the
+ * full MATRIX_SETTLE_US: changed rows on every scan, and unchanged rows of
+ * one column per scan in turn, as a key still settling reads like a
+ * released one. A column failing it goes back to MATRIX_SETTLE_US and is
+ * measured again.
+ */
+static uint8_t col_settle_us[MATRIX_COLS];
+static uint8_t col_settle_max[MATRIX_COLS];
+static uint8_t col_samples[MATRIX_COLS];
+static matrix_rows_t col_rows[MATRIX_COLS];
+static uint8_t col_verify = 0;
+
+uint8_t matrix_settle_time(uint8_t col)
+{
+    return col < MATRIX_COLS ? col_settle_us[col] : MATRIX_SETTLE_US;
+}
+
+static void matrix_init_settle(void)
+{
+    for (int col = 0; col < MATRIX_COLS; col++) {
+        col_settle_us[col] = MATRIX_SETTLE_US;
+        col_settle_max[col] = 0;
+        col_samples[col] = 0;
+        col_rows[col] = 0;
+    }
+}
+
+// microseconds the rows of the driven column take to read settled again
+static uint8_t matrix_measure_settle(int col, matrix_rows_t settled)
+{
+    gpio_write_pin(col_pins[col], 0);
+    // let the column discharge before the next drive
+    wait_us(MATRIX_SETTLE_US);
+    gpio_write_pin(col_pins[col], 1);
+
+    uint8_t us = 0;
+    while (us < MATRIX_SETTLE_US && matrix_read_rows() != settled) {
+        wait_us(1);
+        us++;
+    }
+    return us;
+}
+
+static void matrix_calibrate_settle(int col, matrix_rows_t rows)
+{
+    if (col_samples[col] >= MATRIX_SETTLE_SAMPLES || !rows) {
+        return;
+    }
+
+    uint8_t us = matrix_measure_settle(col, rows);
+    if (us > col_settle_max[col]) {
+        col_settle_max[col] = us;
+    }
+    if (++col_samples[col] == MATRIX_SETTLE_SAMPLES) {
+        uint16_t settle = col_settle_max[col] + MATRIX_SETTLE_MARGIN_US;
+        col_settle_us[col] = settle < MATRIX_SETTLE_US ? settle : MATRIX_SETTLE_US;
+        matrix_scan_debug("col:%d settle %dus\n", col, col_settle_us[col]);
+    }
+}
+
+static matrix_rows_t matrix_verify_rows(int col, matrix_rows_t rows)
+{
+    uint8_t settle = col_settle_us[col];
+    if (settle < MATRIX_SETTLE_US && (rows != col_rows[col] || col == col_verify)) {
+        wait_us(MATRIX_SETTLE_US - settle);
+        matrix_rows_t settled = matrix_read_rows();
+        if (settled != rows) {
+            matrix_scan_debug("col:%d unstable at %dus\n", col, settle);
+            col_settle_us[col] = MATRIX_SETTLE_US;
+            col_settle_max[col] = 0;
+            col_samples[col] = 0;
+            rows = settled;
+        }
+    }
+    col_rows[col] = rows;
+    return rows;
+}
+#else
+uint8_t matrix_settle_time(uint8_t col)
+{
+    return MATRIX_SETTLE_US;
+}
+#endif
+
+#if MATRIX_IDLE_TIMEOUT > 0
+/*
+ * While idle all the columns are driven high, then any key press shows up
+ * as a rising edge on its row pin without scanning. The row edges are armed
+ * as wakeup sources through amk_gpio, so the platform can sleep until one
+ * fires. A platform announces its edge wakeups with AMK_GPIO_EDGE_WAKEUP,
+ * without them or with MATRIX_IDLE_POLL the row pins are polled instead.
+ */
+#if !defined(AMK_GPIO_EDGE_WAKEUP) && !defined(MATRIX_IDLE_POLL)
+#   define MATRIX_IDLE_POLL
+#endif
+
+static bool matrix_idle = false;
+static uint32_t matrix_active_time = 0;
+static volatile bool matrix_wakeup_flag = false;
+
+void matrix_wakeup_signal(void)
+{
+    matrix_wakeup_flag = true;
+}
+
+#ifndef MATRIX_IDLE_POLL
+static void matrix_wakeup_edge(pin_t pin)
+{
+    matrix_wakeup_signal();
+}
+#endif
+
+__attribute__((weak))
+void matrix_wakeup_arm(void)
+{
+#ifndef MATRIX_IDLE_POLL
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        gpio_enable_edge_wakeup(row_pins[row], GPIO_EDGE_RISING, matrix_wakeup_edge);
+    }
+#endif
+}
+
+__attribute__((weak))
+void matrix_wakeup_disarm(void)
+{
+#ifndef MATRIX_IDLE_POLL
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        gpio_disable_edge_wakeup(row_pins[row]);
+    }
+#endif
+}
+
+bool matrix_is_idle(void)
+{
+    return matrix_idle;
+}
+
+static void matrix_idle_enter(void)
+{
+    for (int col = 0; col < MATRIX_COLS; col++) {
+        gpio_write_pin(col_pins[col], 1);
+    }
+
+    matrix_wakeup_flag = false;
+    matrix_wakeup_arm();
+    // a key pressed before the edges were armed gives no edge
+    if (matrix_read_rows() != 0) {
+        matrix_wakeup_flag = true;
+    }
+    matrix_idle = true;
+    matrix_scan_debug("matrix idle\n");
+}
+
+static void matrix_idle_exit(void)
+{
+    matrix_wakeup_disarm();
+    for (int col = 0; col < MATRIX_COLS; col++) {
+        gpio_write_pin(col_pins[col], 0);
+    }
+    matrix_idle = false;
+}
+
+static bool matrix_wakeup_pending(void)
+{
+#ifdef MATRIX_IDLE_POLL
+    return matrix_wakeup_flag || matrix_read_rows() != 0;
+#else
+    return matrix_wakeup_flag;
+#endif
+}
+
+static void matrix_idle_update(matrix_row_t raw[])
+{
+    for (int row = 0; row < MATRIX_ROWS; row++) {
+        if (raw[row]) {
+            matrix_active_time = timer_read32();
+            return;
+        }
+    }
+
+    if (timer_elapsed32(matrix_active_time) >= MATRIX_IDLE_TIMEOUT) {
+        matrix_idle_enter();
+    }
+}
+#endif
+
 void matrix_init_custom(void)
 {
     for (int col = 0; col < MATRIX_COLS; col++) {
@@ -38,37 +344,70 @@ void matrix_init_custom(void)
     for (int row = 0; row < MATRIX_ROWS; row++) {
         gpio_set_input_pulldown(row_pins[row]);
     }
+
+#ifdef MATRIX_PORT_SCAN_ENABLE
+    matrix_init_row_groups();
+#endif
+
+#ifdef MATRIX_SETTLE_CALIBRATE
+    matrix_init_settle();
+#endif
 }
 
 bool matrix_scan_custom(matrix_row_t raw[]) 
 {
     bool changed = false;
+#if MATRIX_IDLE_TIMEOUT > 0
+    if (matrix_idle) {
+        if (!matrix_wakeup_pending()) {
+            return false;
+        }
+        matrix_idle_exit();
+    }
+#endif
+
+    uint16_t scan_time = timer_read();
     for (int col = 0; col < MATRIX_COLS; col++) {
         gpio_write_pin(col_pins[col], 1);
-        wait_us(10);
-
+#ifdef MATRIX_SETTLE_CALIBRATE
+        wait_us(col_settle_us[col]);
+        matrix_rows_t rows = matrix_verify_rows(col, matrix_read_rows());
+        matrix_calibrate_settle(col, rows);
+#else
+        wait_us(MATRIX_SETTLE_US);
+        matrix_rows_t rows = matrix_read_rows();
+#endif
+        matrix_row_t col_mask = (matrix_row_t)1 << col;
         for(uint8_t row = 0; row < MATRIX_ROWS; row++) {
             matrix_row_t last_row_value    = raw[row];
             matrix_row_t current_row_value = last_row_value;
 
-            if (gpio_read_pin(row_pins[row])) {
-                current_row_value |= (1 << col);
+            if (rows & ((matrix_rows_t)1 << row)) {
+                current_row_value |= col_mask;
             } else {
-                current_row_value &= ~(1 << col);
+                current_row_value &= ~col_mask;
             }
 
             if (last_row_value != current_row_value) {
                 raw[row] = current_row_value;
+                row_times[row] = scan_time;
                 changed = true;
             }
         }
         gpio_write_pin(col_pins[col], 0);
     }
+#ifdef MATRIX_SETTLE_CALIBRATE
+    col_verify = (col_verify + 1) % MATRIX_COLS;
+#endif
 
     if (changed) {
         for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
             matrix_scan_debug("row:%d-%x\n", row, matrix_get_row(row));
         }
     }
+
+#if MATRIX_IDLE_TIMEOUT > 0
+    matrix_idle_update(raw);
+#endif
     return changed;
 }
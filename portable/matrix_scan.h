@@ -0,0 +1,26 @@
+/**
+ * @file matrix_scan.h
+ * @author astro
+ *  keyboard matrix scanning implementation, see matrix_scan.c
+ *
+ * With MATRIX_IDLE_TIMEOUT the scanner stops scanning once the matrix was
+ * released that many milliseconds and waits for a row edge, see the idle
+ * scanning of matrix_scan.c. With MATRIX_SETTLE_CALIBRATE it measures the
+ * settle time of every column on its rows.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* microseconds waited after driving the column before reading the rows */
+uint8_t matrix_settle_time(uint8_t col);
+
+/* the scanner waits for a row edge instead of scanning */
+bool matrix_is_idle(void);
+/* wake the idle scanner, for the row edge interrupts of the platform */
+void matrix_wakeup_signal(void);
+/* arm and disarm the row edge wakeups, weak, through amk_gpio by default */
+void matrix_wakeup_arm(void);
+void matrix_wakeup_disarm(void);
@@ -8,6 +8,9 @@
 
 #include "qmk_driver.h"
 #include "keyboard.h"
+#ifdef LOG_STORE_ENABLE
+#include "log_store.h"
+#endif
 
 uint8_t keyboard_protocol = 1;
 
@@ -38,25 +41,120 @@ void raw_hid_send_kb(uint8_t *data, uint8_t length) {}
 #ifdef TINYUSB_ENABLE
 #include "tusb.h"
 
+static bool raw_hid_ready(void)
+{
+    return tud_hid_n_ready(ITF_NUM_VIAL);
+}
+
+void host_raw_endpoint_send(const uint8_t *data, uint8_t length)
+{
+    tud_hid_n_report(ITF_NUM_VIAL, 0, data, length);
+}
+#else
+#include "amk_usb.h"
+static bool raw_hid_ready(void)
+{
+    return amk_usb_itf_ready(HID_REPORT_ID_VIAL);
+}
+
+void host_raw_endpoint_send(const uint8_t *data, uint8_t length)
+{
+    amk_usb_itf_send_report(HID_REPORT_ID_VIAL, data, length);
+}
+#endif
+
+#include "via.h"
+#ifdef DYNAMIC_KEYMAP_MACRO_BYTECODE_ENABLE
+#include "dynamic_keymap.h"
+#endif
+
 void raw_hid_send(uint8_t *data, uint8_t length)
 {
+#ifdef LOG_STORE_ENABLE
+    // via jumps to the bootloader right after this reply, without shutdown_quantum()
+    if (data[0] == id_bootloader_jump) {
+        log_store_flush();
+    }
+#endif
+#ifdef DYNAMIC_KEYMAP_MACRO_BYTECODE_ENABLE
+    // the write of the macro buffer which left macros rejected fails
+    if (data[0] == id_dynamic_keymap_macro_set_buffer && dynamic_keymap_macro_rejected()) {
+        data[0] = id_unhandled;
+    }
+#endif
     raw_hid_send_kb(data, length);
-    if (tud_hid_n_ready(ITF_NUM_VIAL)) {
-        tud_hid_n_report(ITF_NUM_VIAL, 0, data, length);
-    } else {
+#ifdef HOST_REPORT_QUEUE_ENABLE
+    // queued in order, a busy endpoint no longer loses the reply
+    host_raw_send(data, length);
+#else
+    if (raw_hid_ready()) {
+        host_raw_endpoint_send(data, length);
+    }
+#endif
+}
+#endif
+
+#ifdef HOST_REPORT_QUEUE_ENABLE
+#include "usb_common.h"
+#ifdef TINYUSB_ENABLE
+#include "tusb.h"
+
+// hid instances of the queued endpoints as the usb descriptors of the board
+// number them, an endpoint without one waits for the device to be usable
+static bool hid_endpoint_ready(uint8_t endpoint)
+{
+    switch (endpoint) {
+#ifdef HOST_ENDPOINT_ITF_KEYBOARD
+    case HOST_ENDPOINT_KEYBOARD:
+        return tud_hid_n_ready(HOST_ENDPOINT_ITF_KEYBOARD);
+#endif
+#ifdef HOST_ENDPOINT_ITF_MOUSE
+    case HOST_ENDPOINT_MOUSE:
+        return tud_hid_n_ready(HOST_ENDPOINT_ITF_MOUSE);
+#endif
+#ifdef HOST_ENDPOINT_ITF_EXTRA
+    case HOST_ENDPOINT_EXTRA:
+        return tud_hid_n_ready(HOST_ENDPOINT_ITF_EXTRA);
+#endif
+    default:
+        return tud_ready();
     }
 }
 #else
 #include "amk_usb.h"
-void raw_hid_send(uint8_t *data, uint8_t length)
+#ifdef NKRO_ENABLE
+#include "keycode_config.h"
+extern keymap_config_t keymap_config;
+#endif
+
+static bool hid_endpoint_ready(uint8_t endpoint)
 {
-    raw_hid_send_kb(data, length);
-    if (amk_usb_itf_ready(HID_REPORT_ID_VIAL)) {
-        amk_usb_itf_send_report(HID_REPORT_ID_VIAL, data, length);
-    } else {
+    switch (endpoint) {
+    case HOST_ENDPOINT_KEYBOARD:
+#ifdef NKRO_ENABLE
+        if (keymap_config.nkro) {
+            return amk_usb_itf_ready(HID_REPORT_ID_NKRO);
+        }
+#endif
+        return amk_usb_itf_ready(HID_REPORT_ID_KEYBOARD);
+    case HOST_ENDPOINT_MOUSE:
+        return amk_usb_itf_ready(HID_REPORT_ID_MOUSE);
+    default:
+        return amk_usb_itf_ready(HID_REPORT_ID_SYSTEM) && amk_usb_itf_ready(HID_REPORT_ID_CONSUMER);
     }
 }
 #endif
+
+// the queue sends to an endpoint only while it takes a report
+bool host_endpoint_ready(uint8_t endpoint)
+{
+#ifdef VIAL_ENABLE
+    if (endpoint == HOST_ENDPOINT_RAW) {
+        return raw_hid_ready();
+    }
+#endif
+    return hid_endpoint_ready(endpoint);
+}
 #endif
 
 // for delay report
@@ -65,5 +163,21 @@ void raw_hid_send(uint8_t *data, uint8_t length)
 
 void amk_report_delay(uint16_t delay)
 {
-   usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
+#ifdef REPORT_SCHEDULER_ENABLE
+    host_report_delay(delay);
+#else
+    host_report_flush();
+    usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
+#endif
+}
+
+// usb reports which have to stay in order with the keyboard reports
+void amk_report_send(uint8_t type, const void *data, uint8_t size)
+{
+#ifdef REPORT_SCHEDULER_ENABLE
+    host_report_raw(type, data, size);
+#else
+    host_report_flush();
+    usb_send_report(type, data, size);
+#endif
 }
@@ -33,10 +33,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "quantum.h"
 
-////////////////////////
-// Caps Lock delay handler
-extern void amk_report_delay(uint16_t delay);
-
 #ifdef BACKLIGHT_ENABLE
 #    include "backlight.h"
 #endif
@@ -49,6 +45,14 @@ extern void amk_report_delay(uint16_t delay);
 #    include "encoder.h"
 #endif
 
+#ifdef DEADLINE_TICK_ENABLE
+#    include "tick_deadline.h"
+#endif
+
+#ifdef LOG_STORE_ENABLE
+#    include "log_store.h"
+#endif
+
 int tp_buttons;
 
 #if defined(RETRO_TAPPING) || defined(RETRO_TAPPING_PER_KEY) || (defined(AUTO_SHIFT_ENABLE) && defined(RETRO_SHIFT))
@@ -137,6 +141,13 @@ if (QS_oneshot_timeout > 0) {
         dprintln();
     }
 #endif
+
+#ifdef DEADLINE_TICK_ENABLE
+    // after processing, so the oneshots and feature timers this event started are armed too
+    if (IS_EVENT(record.event)) {
+        tick_deadline_key_event(&record);
+    }
+#endif
 }
 
 #ifdef SWAP_HANDS_ENABLE
@@ -232,6 +243,103 @@ void process_record_nocache(keyrecord_t *record) {
 }
 #endif
 
+#ifndef NO_ACTION_LAYER
+/* Topmost non transparent layer of every key for the current
+ * layer_state | default_layer_state, so that resolving the action of a key
+ * event is a single table lookup instead of a keymap read per active layer.
+ * The table is updated lazily for the layers toggled since the last lookup,
+ * and rebuilt when the keymap is written.
+ */
+static uint8_t       effective_layer[MATRIX_ROWS][MATRIX_COLS];
+static layer_state_t effective_layer_state = 0;
+static bool          effective_layer_valid = false;
+
+static uint8_t effective_layer_resolve(layer_state_t layers, keypos_t key) {
+    while (layers) {
+        uint8_t layer = get_highest_layer(layers);
+        if (action_for_key(layer, key).code != ACTION_TRANSPARENT) {
+            return layer;
+        }
+        layers &= ~((layer_state_t)1 << layer);
+    }
+    /* fall back to layer 0, same as layer_switch_get_layer() */
+    return 0;
+}
+
+static void effective_layer_update(void) {
+    layer_state_t layers  = layer_state | default_layer_state;
+    layer_state_t changed = layers ^ effective_layer_state;
+    if (effective_layer_valid && !changed) {
+        return;
+    }
+
+    layer_state_t added   = changed & layers;
+    layer_state_t removed = changed & ~layers;
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            keypos_t key   = MAKE_KEYPOS(row, col);
+            uint8_t  layer = effective_layer[row][col];
+            if (!effective_layer_valid || (removed & ((layer_state_t)1 << layer))) {
+                effective_layer[row][col] = effective_layer_resolve(layers, key);
+                continue;
+            }
+            // only the newly enabled layers above the current one can shadow it
+            layer_state_t above = added & ~(((layer_state_t)2 << layer) - 1);
+            if (above) {
+                uint8_t top = effective_layer_resolve(above, key);
+                if (above & ((layer_state_t)1 << top)) {
+                    effective_layer[row][col] = top;
+                }
+            }
+        }
+    }
+    effective_layer_state = layers;
+    effective_layer_valid = true;
+}
+
+static uint8_t effective_layer_get(keypos_t key) {
+    if (key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS) {
+        return layer_switch_get_layer(key);
+    }
+    effective_layer_update();
+    return effective_layer[key.row][key.col];
+}
+
+static action_t effective_layer_get_action(keypos_t key) {
+    return action_for_key(effective_layer_get(key), key);
+}
+
+/** \brief Same as store_or_get_action(), but resolved through the effective layer table. */
+static action_t effective_store_or_get_action(bool pressed, keypos_t key) {
+#    ifndef STRICT_LAYER_RELEASE
+    if (disable_action_cache) {
+        return effective_layer_get_action(key);
+    }
+
+    uint8_t layer;
+    if (pressed) {
+        layer = effective_layer_get(key);
+        update_source_layers_cache(key, layer);
+    } else {
+        layer = read_source_layers_cache(key);
+    }
+    return action_for_key(layer, key);
+#    else
+    return effective_layer_get_action(key);
+#    endif
+}
+#else
+#    define effective_layer_get_action(key) layer_switch_get_action(key)
+#    define effective_store_or_get_action(pressed, key) store_or_get_action(pressed, key)
+#endif
+
+/** \brief Drops the effective layer table, must be called whenever the keymap changes. */
+void effective_layer_invalidate(void) {
+#ifndef NO_ACTION_LAYER
+    effective_layer_valid = false;
+#endif
+}
+
 __attribute__((weak)) bool process_record_quantum(keyrecord_t *record) {
     return true;
 }
@@ -248,7 +356,7 @@ void process_record_tap_hint(keyrecord_t *record) {
         return;
     }
 
-    action_t action = layer_switch_get_action(record->event.key);
+    action_t action = effective_layer_get_action(record->event.key);
 
     switch (action.kind.id) {
 #    ifdef SWAP_HANDS_ENABLE
@@ -295,10 +403,10 @@ void process_record_handler(keyrecord_t *record) {
     if (record->keycode) {
         action = action_for_keycode(record->keycode);
     } else {
-        action = store_or_get_action(record->event.pressed, record->event.key);
+        action = effective_store_or_get_action(record->event.pressed, record->event.key);
     }
 #else
-    action_t action = store_or_get_action(record->event.pressed, record->event.key);
+    action_t action = effective_store_or_get_action(record->event.pressed, record->event.key);
 #endif
     ac_dprintf("ACTION: ");
     debug_action(action);
@@ -1076,6 +1184,11 @@ __attribute__((weak)) void unregister_weak_mods(uint8_t mods) {
  * FIXME: Needs documentation.
  */
 void clear_keyboard(void) {
+#ifdef LOG_STORE_ENABLE
+    // the QMK resets start with clearing the keyboard in shutdown_quantum(),
+    // the writes still in the log store cache would not survive them
+    log_store_flush();
+#endif
     clear_mods();
     clear_keyboard_but_mods();
 }
@@ -1123,10 +1236,10 @@ bool is_tap_record(keyrecord_t *record) {
     if (record->keycode) {
         action = action_for_keycode(record->keycode);
     } else {
-        action = layer_switch_get_action(record->event.key);
+        action = effective_layer_get_action(record->event.key);
     }
 #else
-    action_t action = layer_switch_get_action(record->event.key);
+    action_t action = effective_layer_get_action(record->event.key);
 #endif
     return is_tap_action(action);
 }
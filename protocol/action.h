@@ -0,0 +1,15 @@
+/**
+ * @file action.h
+ * @author astro
+ *  additions to the quantum action.h for protocol/action.c
+ *
+ * Takes the place of the quantum header and pulls it in with include_next,
+ * so protocol/ has to stay in front of quantum/ in the include path.
+ */
+
+#pragma once
+
+#include_next "action.h"
+
+/* drop the effective layer table, whenever the keymap changes */
+void effective_layer_invalidate(void);
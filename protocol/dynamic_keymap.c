@@ -17,12 +17,14 @@
 #include "dynamic_keymap.h"
 #include "keymap_introspection.h"
 #include "action.h"
+#include "keyboard.h"
 #include "eeprom.h"
 #include "progmem.h"
 #include "send_string.h"
 #include "keycodes.h"
 #include "action_tapping.h"
 #include "wait.h"
+#include "debug.h"
 #include <string.h>
 
 #ifdef VIA_ENABLE
@@ -132,6 +134,111 @@ _Static_assert(DYNAMIC_KEYMAP_EEPROM_MAX_ADDR >= DYNAMIC_KEYMAP_MACRO_EEPROM_ADD
 #    define DYNAMIC_KEYMAP_MACRO_DELAY TAP_CODE_DELAY
 #endif
 
+#define DYNAMIC_KEYMAP_LAYER_SIZE (MATRIX_ROWS * MATRIX_COLS * 2)
+
+#ifdef LOG_STORE_ENABLE
+#    include "log_store.h"
+
+_Static_assert(DYNAMIC_KEYMAP_EEPROM_MAX_ADDR + 1 - DYNAMIC_KEYMAP_EEPROM_ADDR <= LOG_STORE_SIZE, "LOG_STORE_SIZE is too small for the dynamic keymap.");
+
+// The dynamic keymap lives in the log store, at its offset from DYNAMIC_KEYMAP_EEPROM_ADDR
+static void dynamic_keymap_storage_read(void *data, const void *address, uint16_t size) {
+    log_store_read((uintptr_t)address - DYNAMIC_KEYMAP_EEPROM_ADDR, data, size);
+}
+
+static void dynamic_keymap_storage_update(const void *data, void *address, uint16_t size) {
+    log_store_write((uintptr_t)address - DYNAMIC_KEYMAP_EEPROM_ADDR, data, size);
+}
+
+// Blocks the log store has no record of yet are still in the EEPROM
+void log_store_backing_read(uint16_t offset, void *data, uint16_t size) {
+    eeprom_read_block(data, (void *)(DYNAMIC_KEYMAP_EEPROM_ADDR + offset), size);
+}
+#else
+// Block access to the storage behind the dynamic keymap. Updates compare
+// against the stored contents and only write the runs which differ.
+static void dynamic_keymap_storage_read(void *data, const void *address, uint16_t size) {
+    eeprom_read_block(data, address, size);
+}
+
+static void dynamic_keymap_storage_update(const void *data, void *address, uint16_t size) {
+    const uint8_t *source = data;
+    uint8_t        current[32];
+    while (size) {
+        uint16_t chunk = size < sizeof(current) ? size : sizeof(current);
+        eeprom_read_block(current, address, chunk);
+        for (uint16_t i = 0; i < chunk;) {
+            if (current[i] == source[i]) {
+                i++;
+                continue;
+            }
+            uint16_t run = i;
+            while (i < chunk && current[i] != source[i]) {
+                i++;
+            }
+            eeprom_write_block(source + run, address + run, i - run);
+        }
+        address += chunk;
+        source += chunk;
+        size -= chunk;
+    }
+}
+#endif
+
+static uint8_t dynamic_keymap_storage_read_byte(const void *address) {
+    uint8_t value;
+    dynamic_keymap_storage_read(&value, address, sizeof(value));
+    return value;
+}
+
+static void dynamic_keymap_storage_update_byte(void *address, uint8_t value) {
+    dynamic_keymap_storage_update(&value, address, sizeof(value));
+}
+
+// RAM mirror of the keymap layers, so that keycode lookups on every key event
+// do not go through the (possibly flash emulated) EEPROM.
+// Set DYNAMIC_KEYMAP_CACHE_MAX_SIZE to cap the RAM used, only the layers fitting
+// into it will be cached, the others are still read from EEPROM. 0 disables the cache.
+#ifndef DYNAMIC_KEYMAP_CACHE_MAX_SIZE
+#    define DYNAMIC_KEYMAP_CACHE_MAX_SIZE (DYNAMIC_KEYMAP_LAYER_COUNT * DYNAMIC_KEYMAP_LAYER_SIZE)
+#endif
+
+#if DYNAMIC_KEYMAP_CACHE_MAX_SIZE >= DYNAMIC_KEYMAP_LAYER_COUNT * DYNAMIC_KEYMAP_LAYER_SIZE
+#    define DYNAMIC_KEYMAP_CACHE_LAYERS DYNAMIC_KEYMAP_LAYER_COUNT
+#else
+#    define DYNAMIC_KEYMAP_CACHE_LAYERS (DYNAMIC_KEYMAP_CACHE_MAX_SIZE / DYNAMIC_KEYMAP_LAYER_SIZE)
+#endif
+
+#define DYNAMIC_KEYMAP_CACHE_SIZE (DYNAMIC_KEYMAP_CACHE_LAYERS * DYNAMIC_KEYMAP_LAYER_SIZE)
+
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+static uint16_t keymap_cache[DYNAMIC_KEYMAP_CACHE_LAYERS][MATRIX_ROWS][MATRIX_COLS];
+
+void dynamic_keymap_cache_init(void) {
+    // Read the raw big endian data in place, then convert it to native keycodes
+    uint8_t * raw     = (uint8_t *)keymap_cache;
+    uint16_t *keycode = (uint16_t *)keymap_cache;
+    dynamic_keymap_storage_read(raw, (void *)DYNAMIC_KEYMAP_EEPROM_ADDR, DYNAMIC_KEYMAP_CACHE_SIZE);
+    for (uint16_t i = 0; i < DYNAMIC_KEYMAP_CACHE_SIZE / 2; i++) {
+        keycode[i] = (raw[i * 2] << 8) | raw[i * 2 + 1];
+    }
+}
+
+static void dynamic_keymap_cache_update(uint16_t offset, uint16_t size, const uint8_t *data) {
+    uint16_t *keycode = (uint16_t *)keymap_cache;
+    for (uint16_t i = 0; i < size && offset + i < DYNAMIC_KEYMAP_CACHE_SIZE; i++) {
+        uint16_t index = (offset + i) / 2;
+        if ((offset + i) & 1) {
+            keycode[index] = (keycode[index] & 0xFF00) | data[i];
+        } else {
+            keycode[index] = (keycode[index] & 0x00FF) | (data[i] << 8);
+        }
+    }
+}
+#else
+void dynamic_keymap_cache_init(void) {}
+#endif
+
 uint8_t dynamic_keymap_get_layer_count(void) {
     return DYNAMIC_KEYMAP_LAYER_COUNT;
 }
@@ -143,10 +250,15 @@ void *dynamic_keymap_key_to_eeprom_address(uint8_t layer, uint8_t row, uint8_t c
 
 uint16_t dynamic_keymap_get_keycode(uint8_t layer, uint8_t row, uint8_t column) {
     if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || row >= MATRIX_ROWS || column >= MATRIX_COLS) return KC_NO;
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+    if (layer < DYNAMIC_KEYMAP_CACHE_LAYERS) {
+        return keymap_cache[layer][row][column];
+    }
+#endif
     void *address = dynamic_keymap_key_to_eeprom_address(layer, row, column);
     // Big endian, so we can read/write EEPROM directly from host if we want
-    uint16_t keycode = eeprom_read_byte(address) << 8;
-    keycode |= eeprom_read_byte(address + 1);
+    uint16_t keycode = dynamic_keymap_storage_read_byte(address) << 8;
+    keycode |= dynamic_keymap_storage_read_byte(address + 1);
     return keycode;
 }
 
@@ -156,8 +268,17 @@ void dynamic_keymap_set_keycode(uint8_t layer, uint8_t row, uint8_t column, uint
     if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || row >= MATRIX_ROWS || column >= MATRIX_COLS) return;
     void *address = dynamic_keymap_key_to_eeprom_address(layer, row, column);
     // Big endian, so we can read/write EEPROM directly from host if we want
-    eeprom_update_byte(address, (uint8_t)(keycode >> 8));
-    eeprom_update_byte(address + 1, (uint8_t)(keycode & 0xFF));
+    dynamic_keymap_storage_update_byte(address, (uint8_t)(keycode >> 8));
+    dynamic_keymap_storage_update_byte(address + 1, (uint8_t)(keycode & 0xFF));
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+    if (layer < DYNAMIC_KEYMAP_CACHE_LAYERS) {
+        keymap_cache[layer][row][column] = keycode;
+    }
+#endif
+    effective_layer_invalidate();
+    if (layer == 0) {
+        ghost_real_keys_invalidate();
+    }
     dynamic_keymap_set_keycode_kb(layer, row, column, keycode);
 }
 
@@ -170,8 +291,8 @@ uint16_t dynamic_keymap_get_encoder(uint8_t layer, uint8_t encoder_id, bool cloc
     if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || encoder_id >= NUM_ENCODERS) return KC_NO;
     void *address = dynamic_keymap_encoder_to_eeprom_address(layer, encoder_id);
     // Big endian, so we can read/write EEPROM directly from host if we want
-    uint16_t keycode = ((uint16_t)eeprom_read_byte(address + (clockwise ? 0 : 2))) << 8;
-    keycode |= eeprom_read_byte(address + (clockwise ? 0 : 2) + 1);
+    uint16_t keycode = ((uint16_t)dynamic_keymap_storage_read_byte(address + (clockwise ? 0 : 2))) << 8;
+    keycode |= dynamic_keymap_storage_read_byte(address + (clockwise ? 0 : 2) + 1);
     return keycode;
 }
 
@@ -179,8 +300,8 @@ void dynamic_keymap_set_encoder(uint8_t layer, uint8_t encoder_id, bool clockwis
     if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || encoder_id >= NUM_ENCODERS) return;
     void *address = dynamic_keymap_encoder_to_eeprom_address(layer, encoder_id);
     // Big endian, so we can read/write EEPROM directly from host if we want
-    eeprom_update_byte(address + (clockwise ? 0 : 2), (uint8_t)(keycode >> 8));
-    eeprom_update_byte(address + (clockwise ? 0 : 2) + 1, (uint8_t)(keycode & 0xFF));
+    dynamic_keymap_storage_update_byte(address + (clockwise ? 0 : 2), (uint8_t)(keycode >> 8));
+    dynamic_keymap_storage_update_byte(address + (clockwise ? 0 : 2) + 1, (uint8_t)(keycode & 0xFF));
 }
 #endif // ENCODER_MAP_ENABLE
 
@@ -190,7 +311,7 @@ uint8_t dynamic_keymap_get_qmk_settings(uint16_t offset) {
         return 0;
 
     void *address = (void*)(VIAL_QMK_SETTINGS_EEPROM_ADDR + offset);
-    return eeprom_read_byte(address);
+    return dynamic_keymap_storage_read_byte(address);
 }
 
 void dynamic_keymap_set_qmk_settings(uint16_t offset, uint8_t value) {
@@ -198,7 +319,7 @@ void dynamic_keymap_set_qmk_settings(uint16_t offset, uint8_t value) {
         return;
 
     void *address = (void*)(VIAL_QMK_SETTINGS_EEPROM_ADDR + offset);
-    eeprom_update_byte(address, value);
+    dynamic_keymap_storage_update_byte(address, value);
 }
 #endif
 
@@ -208,7 +329,7 @@ int dynamic_keymap_get_tap_dance(uint8_t index, vial_tap_dance_entry_t *entry) {
         return -1;
 
     void *address = (void*)(VIAL_TAP_DANCE_EEPROM_ADDR + index * sizeof(vial_tap_dance_entry_t));
-    eeprom_read_block(entry, address, sizeof(vial_tap_dance_entry_t));
+    dynamic_keymap_storage_read(entry, address, sizeof(vial_tap_dance_entry_t));
 
     return 0;
 }
@@ -218,7 +339,7 @@ int dynamic_keymap_set_tap_dance(uint8_t index, const vial_tap_dance_entry_t *en
         return -1;
 
     void *address = (void*)(VIAL_TAP_DANCE_EEPROM_ADDR + index * sizeof(vial_tap_dance_entry_t));
-    eeprom_write_block(entry, address, sizeof(vial_tap_dance_entry_t));
+    dynamic_keymap_storage_update(entry, address, sizeof(vial_tap_dance_entry_t));
 
     return 0;
 }
@@ -230,7 +351,7 @@ int dynamic_keymap_get_combo(uint8_t index, vial_combo_entry_t *entry) {
         return -1;
 
     void *address = (void*)(VIAL_COMBO_EEPROM_ADDR + index * sizeof(vial_combo_entry_t));
-    eeprom_read_block(entry, address, sizeof(vial_combo_entry_t));
+    dynamic_keymap_storage_read(entry, address, sizeof(vial_combo_entry_t));
 
     return 0;
 }
@@ -240,7 +361,7 @@ int dynamic_keymap_set_combo(uint8_t index, const vial_combo_entry_t *entry) {
         return -1;
 
     void *address = (void*)(VIAL_COMBO_EEPROM_ADDR + index * sizeof(vial_combo_entry_t));
-    eeprom_write_block(entry, address, sizeof(vial_combo_entry_t));
+    dynamic_keymap_storage_update(entry, address, sizeof(vial_combo_entry_t));
 
     return 0;
 }
@@ -252,7 +373,7 @@ int dynamic_keymap_get_key_override(uint8_t index, vial_key_override_entry_t *en
         return -1;
 
     void *address = (void*)(VIAL_KEY_OVERRIDE_EEPROM_ADDR + index * sizeof(vial_key_override_entry_t));
-    eeprom_read_block(entry, address, sizeof(vial_key_override_entry_t));
+    dynamic_keymap_storage_read(entry, address, sizeof(vial_key_override_entry_t));
 
     return 0;
 }
@@ -262,12 +383,56 @@ int dynamic_keymap_set_key_override(uint8_t index, const vial_key_override_entry
         return -1;
 
     void *address = (void*)(VIAL_KEY_OVERRIDE_EEPROM_ADDR + index * sizeof(vial_key_override_entry_t));
-    eeprom_write_block(entry, address, sizeof(vial_key_override_entry_t));
+    dynamic_keymap_storage_update(entry, address, sizeof(vial_key_override_entry_t));
 
     return 0;
 }
 #endif
 
+__attribute__((weak)) void dynamic_keymap_reset_kb(void) {}
+
+// dynamic_keymap_reset() stages every image in this one buffer, a chunk at a time
+#ifndef DYNAMIC_KEYMAP_RESET_CHUNK_SIZE
+#    define DYNAMIC_KEYMAP_RESET_CHUNK_SIZE 64
+#endif
+
+static uint8_t dynamic_keymap_reset_chunk[DYNAMIC_KEYMAP_RESET_CHUNK_SIZE];
+
+typedef struct {
+    void *   address;
+    uint16_t used;
+} dynamic_keymap_reset_writer_t;
+
+static void dynamic_keymap_reset_flush(dynamic_keymap_reset_writer_t *writer) {
+    if (!writer->used) {
+        return;
+    }
+    dynamic_keymap_storage_update(dynamic_keymap_reset_chunk, writer->address, writer->used);
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+    // past the cached layers this does nothing
+    dynamic_keymap_cache_update((uintptr_t)writer->address - DYNAMIC_KEYMAP_EEPROM_ADDR, writer->used, dynamic_keymap_reset_chunk);
+#endif
+    writer->address += writer->used;
+    writer->used = 0;
+}
+
+static void dynamic_keymap_reset_put(dynamic_keymap_reset_writer_t *writer, const void *data, uint16_t size) {
+    const uint8_t *source = data;
+    while (size) {
+        uint16_t part = sizeof(dynamic_keymap_reset_chunk) - writer->used;
+        if (part > size) {
+            part = size;
+        }
+        memcpy(&dynamic_keymap_reset_chunk[writer->used], source, part);
+        writer->used += part;
+        source += part;
+        size -= part;
+        if (writer->used == sizeof(dynamic_keymap_reset_chunk)) {
+            dynamic_keymap_reset_flush(writer);
+        }
+    }
+}
+
 void dynamic_keymap_reset(void) {
 #ifdef VIAL_ENABLE
     /* temporarily unlock the keyboard so we can set hardcoded QK_BOOT keycode */
@@ -275,71 +440,103 @@ void dynamic_keymap_reset(void) {
     vial_unlocked = 1;
 #endif
 
-    // Reset the keymaps in EEPROM to what is in flash.
+    // Reset the keymaps in EEPROM to what is in flash, big endian like
+    // dynamic_keymap_set_keycode(), staged a chunk at a time.
+    dynamic_keymap_reset_writer_t writer = {dynamic_keymap_key_to_eeprom_address(0, 0, 0), 0};
     for (int layer = 0; layer < DYNAMIC_KEYMAP_LAYER_COUNT; layer++) {
         for (int row = 0; row < MATRIX_ROWS; row++) {
             for (int column = 0; column < MATRIX_COLS; column++) {
-                dynamic_keymap_set_keycode(layer, row, column, keycode_at_keymap_location_raw(layer, row, column));
+                uint16_t keycode = keycode_at_keymap_location_raw(layer, row, column);
+                uint8_t  data[2] = {keycode >> 8, keycode & 0xFF};
+                dynamic_keymap_reset_put(&writer, data, sizeof(data));
             }
         }
+    }
+    dynamic_keymap_reset_flush(&writer);
+    effective_layer_invalidate();
+    ghost_real_keys_invalidate();
+
 #ifdef ENCODER_MAP_ENABLE
+    writer.address = (void *)DYNAMIC_KEYMAP_ENCODER_EEPROM_ADDR;
+    for (int layer = 0; layer < DYNAMIC_KEYMAP_LAYER_COUNT; layer++) {
         for (int encoder = 0; encoder < NUM_ENCODERS; encoder++) {
-            dynamic_keymap_set_encoder(layer, encoder, true, keycode_at_encodermap_location_raw(layer, encoder, true));
-            dynamic_keymap_set_encoder(layer, encoder, false, keycode_at_encodermap_location_raw(layer, encoder, false));
+            uint16_t cw      = keycode_at_encodermap_location_raw(layer, encoder, true);
+            uint16_t ccw     = keycode_at_encodermap_location_raw(layer, encoder, false);
+            uint8_t  data[4] = {cw >> 8, cw & 0xFF, ccw >> 8, ccw & 0xFF};
+            dynamic_keymap_reset_put(&writer, data, sizeof(data));
         }
-#endif // ENCODER_MAP_ENABLE
     }
+    dynamic_keymap_reset_flush(&writer);
+#endif // ENCODER_MAP_ENABLE
 
 #ifdef QMK_SETTINGS
     qmk_settings_reset();
 #endif
 
 #ifdef VIAL_TAP_DANCE_ENABLE
-    vial_tap_dance_entry_t td = { KC_NO, KC_NO, KC_NO, KC_NO, TAPPING_TERM };
+    const vial_tap_dance_entry_t td = { KC_NO, KC_NO, KC_NO, KC_NO, TAPPING_TERM };
+    writer.address = (void *)VIAL_TAP_DANCE_EEPROM_ADDR;
     for (size_t i = 0; i < VIAL_TAP_DANCE_ENTRIES; ++i) {
-        dynamic_keymap_set_tap_dance(i, &td);
+        dynamic_keymap_reset_put(&writer, &td, sizeof(td));
     }
+    dynamic_keymap_reset_flush(&writer);
 #endif
 
 #ifdef VIAL_COMBO_ENABLE
-    vial_combo_entry_t combo = { 0 };
-    for (size_t i = 0; i < VIAL_COMBO_ENTRIES; ++i)
-        dynamic_keymap_set_combo(i, &combo);
+    const vial_combo_entry_t combo = {0};
+    writer.address = (void *)VIAL_COMBO_EEPROM_ADDR;
+    for (size_t i = 0; i < VIAL_COMBO_ENTRIES; ++i) {
+        dynamic_keymap_reset_put(&writer, &combo, sizeof(combo));
+    }
+    dynamic_keymap_reset_flush(&writer);
 #endif
 
 #ifdef VIAL_KEY_OVERRIDE_ENABLE
-    vial_key_override_entry_t ko = { 0 };
-    ko.layers = ~0;
+    vial_key_override_entry_t ko;
+    memset(&ko, 0, sizeof(ko));
+    ko.layers  = ~0;
     ko.options = vial_ko_option_activation_negative_mod_up | vial_ko_option_activation_required_mod_down | vial_ko_option_activation_trigger_down;
-    for (size_t i = 0; i < VIAL_KEY_OVERRIDE_ENTRIES; ++i)
-        dynamic_keymap_set_key_override(i, &ko);
+    writer.address = (void *)VIAL_KEY_OVERRIDE_EEPROM_ADDR;
+    for (size_t i = 0; i < VIAL_KEY_OVERRIDE_ENTRIES; ++i) {
+        dynamic_keymap_reset_put(&writer, &ko, sizeof(ko));
+    }
+    dynamic_keymap_reset_flush(&writer);
 #endif
 
 #ifdef VIAL_ENABLE
     /* re-lock the keyboard */
     vial_unlocked = vial_unlocked_prev;
 #endif
+
+    // one notification for the whole keymap instead of dynamic_keymap_set_keycode_kb() per key
+    dynamic_keymap_reset_kb();
 }
 
 void dynamic_keymap_get_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
     uint16_t dynamic_keymap_eeprom_size = DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2;
-    void *   source                     = (void *)(DYNAMIC_KEYMAP_EEPROM_ADDR + offset);
-    uint8_t *target                     = data;
-    for (uint16_t i = 0; i < size; i++) {
-        if (offset + i < dynamic_keymap_eeprom_size) {
-            *target = eeprom_read_byte(source);
-        } else {
-            *target = 0x00;
-        }
-        source++;
-        target++;
+    uint16_t stored                     = 0;
+    if (offset < dynamic_keymap_eeprom_size) {
+        stored = size < dynamic_keymap_eeprom_size - offset ? size : dynamic_keymap_eeprom_size - offset;
+    }
+
+    uint16_t cached = 0;
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+    // the cached layers are served from RAM, big endian like in storage
+    const uint16_t *keycode = (const uint16_t *)keymap_cache;
+    for (; cached < stored && offset + cached < DYNAMIC_KEYMAP_CACHE_SIZE; cached++) {
+        uint16_t index = (offset + cached) / 2;
+        data[cached]   = ((offset + cached) & 1) ? keycode[index] & 0xFF : keycode[index] >> 8;
     }
+#endif
+    if (cached < stored) {
+        dynamic_keymap_storage_read(data + cached, (void *)(DYNAMIC_KEYMAP_EEPROM_ADDR + offset + cached), stored - cached);
+    }
+    memset(data + stored, 0, size - stored);
 }
 
 void dynamic_keymap_set_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
     uint16_t dynamic_keymap_eeprom_size = DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2;
     void *   target                     = (void *)(DYNAMIC_KEYMAP_EEPROM_ADDR + offset);
-    uint8_t *source                     = data;
 
 #ifdef VIAL_ENABLE
     /* ensure the writes are bounded */
@@ -355,7 +552,7 @@ void dynamic_keymap_set_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
 
         /* initial byte misaligned -- this means the first keycode will be a combination of existing and new data */
         if (offset % 2 != 0) {
-            uint16_t kc = (eeprom_read_byte((uint8_t*)target - 1) << 8) | data[0];
+            uint16_t kc = (dynamic_keymap_storage_read_byte((uint8_t*)target - 1) << 8) | data[0];
             if (kc == QK_BOOT)
                 data[0] = 0xFF;
 
@@ -365,7 +562,7 @@ void dynamic_keymap_set_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
 
         /* final byte misaligned -- this means the last keycode will be a combination of new and existing data */
         if ((offset + size) % 2 != 0) {
-            uint16_t kc = (data[size - 1] << 8) | eeprom_read_byte((uint8_t*)target + size);
+            uint16_t kc = (data[size - 1] << 8) | dynamic_keymap_storage_read_byte((uint8_t*)target + size);
             if (kc == QK_BOOT)
                 data[size - 1] = 0xFF;
 
@@ -385,12 +582,16 @@ void dynamic_keymap_set_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
 #endif
 #endif
 
-    for (uint16_t i = 0; i < size; i++) {
-        if (offset + i < dynamic_keymap_eeprom_size) {
-            eeprom_update_byte(target, *source);
-        }
-        source++;
-        target++;
+    if (offset < dynamic_keymap_eeprom_size) {
+        uint16_t stored = size < dynamic_keymap_eeprom_size - offset ? size : dynamic_keymap_eeprom_size - offset;
+        dynamic_keymap_storage_update(data, target, stored);
+    }
+#if DYNAMIC_KEYMAP_CACHE_LAYERS > 0
+    dynamic_keymap_cache_update(offset, size, data);
+#endif
+    effective_layer_invalidate();
+    if (offset < MATRIX_ROWS * MATRIX_COLS * 2) {
+        ghost_real_keys_invalidate();
     }
 }
 
@@ -410,6 +611,9 @@ uint16_t keycode_at_encodermap_location(uint8_t layer_num, uint8_t encoder_idx,
 }
 #endif // ENCODER_MAP_ENABLE
 
+static void dynamic_keymap_macro_index_invalidate(void);
+static void dynamic_keymap_macro_index_update(void);
+
 uint8_t dynamic_keymap_macro_get_count(void) {
     return DYNAMIC_KEYMAP_MACRO_COUNT;
 }
@@ -419,38 +623,36 @@ uint16_t dynamic_keymap_macro_get_buffer_size(void) {
 }
 
 void dynamic_keymap_macro_get_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
-    void *   source = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset);
-    uint8_t *target = data;
-    for (uint16_t i = 0; i < size; i++) {
-        if (offset + i < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
-            *target = eeprom_read_byte(source);
-        } else {
-            *target = 0x00;
-        }
-        source++;
-        target++;
+    uint16_t stored = 0;
+    if (offset < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+        stored = size < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset ? size : DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset;
+        dynamic_keymap_storage_read(data, (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset), stored);
     }
+    memset(data + stored, 0, size - stored);
 }
 
 void dynamic_keymap_macro_set_buffer(uint16_t offset, uint16_t size, uint8_t *data) {
-    void *   target = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset);
-    uint8_t *source = data;
-    for (uint16_t i = 0; i < size; i++) {
-        if (offset + i < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
-            eeprom_update_byte(target, *source);
+    dynamic_keymap_macro_cancel();
+    dynamic_keymap_macro_index_invalidate();
+    if (offset < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+        uint16_t stored = size < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset ? size : DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset;
+        dynamic_keymap_storage_update(data, (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset), stored);
+        // the host finishes a write with the null at the end of the buffer
+        if (offset + stored == DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+            dynamic_keymap_macro_index_update();
         }
-        source++;
-        target++;
     }
 }
 
 void dynamic_keymap_macro_reset(void) {
-    void *p   = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR);
-    void *end = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE);
-    while (p != end) {
-        eeprom_update_byte(p, 0);
-        ++p;
+    dynamic_keymap_macro_cancel();
+    dynamic_keymap_macro_index_invalidate();
+    uint8_t zero[32] = {0};
+    for (uint16_t offset = 0; offset < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE; offset += sizeof(zero)) {
+        uint16_t size = DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset;
+        dynamic_keymap_storage_update(zero, (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset), size < sizeof(zero) ? size : sizeof(zero));
     }
+    dynamic_keymap_macro_index_update();
 }
 
 static uint16_t decode_keycode(uint16_t kc) {
@@ -462,105 +664,636 @@ static uint16_t decode_keycode(uint16_t kc) {
 
 #include "usb_common.h"
 #include "usb_interface.h"
+#include "host.h"
 
-void dynamic_keymap_macro_send(uint8_t id) {
-    if (id >= DYNAMIC_KEYMAP_MACRO_COUNT) {
-        return;
+#define MACRO_OFFSET_NONE 0xFFFF
+
+/*
+ * Start of each macro in the macro buffer, or in its bytecode, rebuilt with
+ * a single pass over the buffer when the host writes its last byte, or by
+ * the next lookup after any other write.
+ */
+static uint16_t macro_offsets[DYNAMIC_KEYMAP_MACRO_COUNT];
+static bool     macro_index_valid      = false;
+static bool     macro_index_terminated = false;
+static uint8_t  macro_rejected         = 0;
+
+static void dynamic_keymap_macro_index_invalidate(void) {
+    macro_index_valid = false;
+    macro_rejected    = 0;
+}
+
+uint8_t dynamic_keymap_macro_rejected(void) {
+    return macro_rejected;
+}
+
+#ifdef DYNAMIC_KEYMAP_MACRO_BYTECODE_ENABLE
+/*
+ * The macros are compiled when the host writes the last byte of the buffer,
+ * the null VIA and Vial terminate a write with, and once at startup. Each op
+ * is followed by its operands, plain chars are stored as themselves. Macros
+ * with a truncated or unknown action are rejected as a whole instead of
+ * being played up to the broken part, the reply to the write tells the host.
+ * The macros not fitting DYNAMIC_KEYMAP_MACRO_BYTECODE_SIZE stay in the
+ * buffer and are decoded as they play.
+ */
+enum {
+    MACRO_OP_END,       // end of the macro
+    MACRO_OP_TAP,       // basic keycode
+    MACRO_OP_DOWN,      // basic keycode
+    MACRO_OP_UP,        // basic keycode
+    MACRO_OP_DELAY,     // little endian milliseconds
+    MACRO_OP_EXT_TAP,   // little endian keycode
+    MACRO_OP_EXT_DOWN,  // little endian keycode
+    MACRO_OP_EXT_UP,    // little endian keycode
+    MACRO_OP_CHAR_BASE, // chars below are not valid in macros
+};
+
+#    ifndef DYNAMIC_KEYMAP_MACRO_BYTECODE_SIZE
+#        define DYNAMIC_KEYMAP_MACRO_BYTECODE_SIZE 256
+#    endif
+#    define MACRO_BYTECODE_SIZE (DYNAMIC_KEYMAP_MACRO_BYTECODE_SIZE < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE ? DYNAMIC_KEYMAP_MACRO_BYTECODE_SIZE : DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE)
+
+// marks the offset of a macro played from the buffer
+#    define MACRO_OFFSET_STORED 0x8000
+
+_Static_assert(DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE < MACRO_OFFSET_STORED, "DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE is too large for the macro bytecode.");
+
+static uint8_t macro_bytecode[MACRO_BYTECODE_SIZE];
+
+typedef struct {
+    uint8_t  op;
+    uint16_t value;
+} macro_op_t;
+
+typedef struct {
+    uint16_t offset;
+    uint8_t  pos;
+    uint8_t  size;
+    uint8_t  limit;
+    uint8_t  buffer[32];
+} macro_reader_t;
+
+// the longest action, what playing reads at a time
+#    define MACRO_READER_ACTION 4
+
+// next byte of the macro buffer, 0 past its end
+static uint8_t macro_reader_next(macro_reader_t *reader) {
+    if (reader->pos == reader->size) {
+        if (reader->offset >= DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+            return 0;
+        }
+        uint16_t size = DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - reader->offset;
+        uint8_t  max  = reader->limit ? reader->limit : sizeof(reader->buffer);
+        reader->size  = size > max ? max : size;
+        reader->pos   = 0;
+        dynamic_keymap_storage_read(reader->buffer, (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + reader->offset), reader->size);
+        reader->offset += reader->size;
     }
+    return reader->buffer[reader->pos++];
+}
+
+// offset of the next byte the reader returns
+static uint16_t macro_reader_tell(const macro_reader_t *reader) {
+    return reader->offset - (reader->size - reader->pos);
+}
+
+enum {
+    MACRO_DECODE_END,
+    MACRO_DECODE_OP,
+    MACRO_DECODE_ERROR,
+};
 
+// rejects the macro, reading on to its null unless c already was it
+static uint8_t macro_decode_error(macro_reader_t *reader, uint8_t c) {
+    while (c != 0) {
+        c = macro_reader_next(reader);
+    }
+    return MACRO_DECODE_ERROR;
+}
+
+// decodes the next op of the macro text
+static uint8_t macro_decode(macro_reader_t *reader, macro_op_t *op) {
+    uint8_t c = macro_reader_next(reader);
+    if (c == 0) {
+        return MACRO_DECODE_END;
+    }
+    if (c != SS_QMK_PREFIX) {
+        if (c < MACRO_OP_CHAR_BASE) {
+            return macro_decode_error(reader, c);
+        }
+        op->op = c;
+        return MACRO_DECODE_OP;
+    }
+
+    // a null operand is the end of the macro, so the action is cut off
+    uint8_t action = macro_reader_next(reader);
+    if (action == SS_TAP_CODE || action == SS_DOWN_CODE || action == SS_UP_CODE) {
+        uint8_t keycode = macro_reader_next(reader);
+        if (keycode == 0) {
+            return MACRO_DECODE_ERROR;
+        }
+        op->op    = action == SS_TAP_CODE ? MACRO_OP_TAP : action == SS_DOWN_CODE ? MACRO_OP_DOWN : MACRO_OP_UP;
+        op->value = keycode;
+    } else if (action == VIAL_MACRO_EXT_TAP || action == VIAL_MACRO_EXT_DOWN || action == VIAL_MACRO_EXT_UP) {
+        uint8_t lo = macro_reader_next(reader);
+        uint8_t hi = lo ? macro_reader_next(reader) : 0;
+        if (lo == 0 || hi == 0) {
+            return MACRO_DECODE_ERROR;
+        }
+        op->op    = action == VIAL_MACRO_EXT_TAP ? MACRO_OP_EXT_TAP : action == VIAL_MACRO_EXT_DOWN ? MACRO_OP_EXT_DOWN : MACRO_OP_EXT_UP;
+        op->value = decode_keycode(lo | (hi << 8));
+    } else if (action == SS_DELAY_CODE) {
+        uint8_t d0 = macro_reader_next(reader);
+        uint8_t d1 = d0 ? macro_reader_next(reader) : 0;
+        if (d0 == 0 || d1 == 0) {
+            return MACRO_DECODE_ERROR;
+        }
+        // we cannot use 0 for these, need to subtract 1 and use 255 instead of 256 for delay calculation
+        op->op    = MACRO_OP_DELAY;
+        op->value = (d0 - 1) + (d1 - 1) * 255;
+    } else {
+        return macro_decode_error(reader, action);
+    }
+    return MACRO_DECODE_OP;
+}
+
+// bytes of the op and its operands in the bytecode
+static uint8_t macro_op_size(uint8_t op) {
+    switch (op) {
+        case MACRO_OP_TAP:
+        case MACRO_OP_DOWN:
+        case MACRO_OP_UP:
+            return 2;
+        case MACRO_OP_DELAY:
+        case MACRO_OP_EXT_TAP:
+        case MACRO_OP_EXT_DOWN:
+        case MACRO_OP_EXT_UP:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+// appends the op to the bytecode, false if it does not fit
+static bool macro_emit(const macro_op_t *op, uint16_t *out) {
+    uint8_t size = macro_op_size(op->op);
+    if (*out + size > MACRO_BYTECODE_SIZE) {
+        return false;
+    }
+    uint8_t *code = &macro_bytecode[*out];
+    code[0]       = op->op;
+    if (size > 1) {
+        code[1] = op->value & 0xFF;
+    }
+    if (size > 2) {
+        code[2] = op->value >> 8;
+    }
+    *out += size;
+    return true;
+}
+
+static void dynamic_keymap_macro_index_update(void) {
     // Check the last byte of the buffer.
     // If it's not zero, then we are in the middle
     // of buffer writing, possibly an aborted buffer
     // write. So do nothing.
-    void *p = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - 1);
-    if (eeprom_read_byte(p) != 0) {
+    void *p                = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - 1);
+    macro_index_terminated = dynamic_keymap_storage_read_byte(p) == 0;
+    macro_index_valid      = true;
+    if (!macro_index_terminated) {
         return;
     }
 
-    usb_send_report(HID_REPORT_ID_MACRO_BEGIN, &id, sizeof(id));
+    macro_reader_t reader = {0};
+    uint16_t       out    = 0;
+    for (uint8_t id = 0; id < DYNAMIC_KEYMAP_MACRO_COUNT; id++) {
+        uint16_t text = macro_reader_tell(&reader);
+        // there were not DYNAMIC_KEYMAP_MACRO_COUNT nulls in the buffer
+        if (text >= DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+            macro_offsets[id] = MACRO_OFFSET_NONE;
+            continue;
+        }
 
-    // Skip N null characters
-    // p will then point to the Nth macro
-    p         = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR);
-    void *end = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE);
-    while (id > 0) {
-        // If we are past the end of the buffer, then the buffer
-        // contents are garbage, i.e. there were not DYNAMIC_KEYMAP_MACRO_COUNT
-        // nulls in the buffer.
-        if (p == end) {
+        uint16_t   start = out;
+        bool       fits  = true;
+        macro_op_t op;
+        uint8_t    decoded;
+        while ((decoded = macro_decode(&reader, &op)) == MACRO_DECODE_OP) {
+            fits = fits && macro_emit(&op, &out);
+        }
+
+        op.op = MACRO_OP_END;
+        if (decoded == MACRO_DECODE_ERROR) {
+            dprintf("macro %d: malformed, rejected\n", id);
+            macro_offsets[id] = MACRO_OFFSET_NONE;
+            macro_rejected++;
+            out = start;
+        } else if (fits && macro_emit(&op, &out)) {
+            macro_offsets[id] = start;
+        } else {
+            macro_offsets[id] = MACRO_OFFSET_STORED | text;
+            out               = start;
+        }
+    }
+}
+#else
+static void dynamic_keymap_macro_index_update(void) {
+    // Check the last byte of the buffer.
+    // If it's not zero, then we are in the middle
+    // of buffer writing, possibly an aborted buffer
+    // write. So do nothing.
+    void *p                = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - 1);
+    macro_index_terminated = dynamic_keymap_storage_read_byte(p) == 0;
+    macro_index_valid      = true;
+
+    // Macro N starts after the Nth null character
+    uint8_t  buffer[32];
+    uint8_t  id     = 0;
+    uint16_t offset = 0;
+    macro_offsets[id++] = 0;
+    while (id < DYNAMIC_KEYMAP_MACRO_COUNT && offset < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE) {
+        uint16_t size = DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE - offset;
+        if (size > sizeof(buffer)) {
+            size = sizeof(buffer);
+        }
+        dynamic_keymap_storage_read(buffer, (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + offset), size);
+        for (uint16_t i = 0; i < size && id < DYNAMIC_KEYMAP_MACRO_COUNT; i++) {
+            if (buffer[i] == 0) {
+                // a macro starting past the end of the buffer is garbage
+                macro_offsets[id++] = offset + i + 1 < DYNAMIC_KEYMAP_MACRO_EEPROM_SIZE ? offset + i + 1 : MACRO_OFFSET_NONE;
+            }
+        }
+        offset += size;
+    }
+
+    // If we are past the end of the buffer, then the buffer
+    // contents are garbage, i.e. there were not DYNAMIC_KEYMAP_MACRO_COUNT
+    // nulls in the buffer.
+    while (id < DYNAMIC_KEYMAP_MACRO_COUNT) {
+        macro_offsets[id++] = MACRO_OFFSET_NONE;
+    }
+}
+#endif
+
+void dynamic_keymap_macro_init(void) {
+    dynamic_keymap_macro_index_update();
+}
+
+// Offset of the macro in the macro buffer, false if there is none or the
+// buffer is not terminated, e.g. while the host is still writing it
+static bool dynamic_keymap_macro_find(uint8_t id, uint16_t *offset) {
+    if (!macro_index_valid) {
+        // a write which did not end at the last byte of the buffer
+        dynamic_keymap_macro_index_update();
+    }
+    if (!macro_index_terminated || macro_offsets[id] == MACRO_OFFSET_NONE) {
+        return false;
+    }
+
+    *offset = macro_offsets[id];
+    return true;
+}
+
+#ifdef DYNAMIC_KEYMAP_MACRO_ASYNC_ENABLE
+// keys a playing macro keeps track of, to release them when it is cancelled
+#    ifndef DYNAMIC_KEYMAP_MACRO_HELD_KEYS
+#        define DYNAMIC_KEYMAP_MACRO_HELD_KEYS 8
+#    endif
+
+/*
+ * Keys pressed by the playing macro and not released yet. A cancelled
+ * macro releases them the way they were pressed, or clears the keyboard
+ * if it held more than it could keep track of. A macro running to its end
+ * keeps the keys it leaves down on purpose.
+ */
+typedef struct {
+    uint16_t keycode;
+    bool     ext;
+} macro_held_key_t;
+
+static macro_held_key_t macro_held[DYNAMIC_KEYMAP_MACRO_HELD_KEYS];
+static uint8_t          macro_held_count    = 0;
+static bool             macro_held_overflow = false;
+
+static void macro_held_down(uint16_t keycode, bool ext) {
+    for (uint8_t i = 0; i < macro_held_count; i++) {
+        if (macro_held[i].keycode == keycode && macro_held[i].ext == ext) {
+            return;
+        }
+    }
+    if (macro_held_count == DYNAMIC_KEYMAP_MACRO_HELD_KEYS) {
+        macro_held_overflow = true;
+        return;
+    }
+    macro_held[macro_held_count].keycode = keycode;
+    macro_held[macro_held_count].ext     = ext;
+    macro_held_count++;
+}
+
+static void macro_held_up(uint16_t keycode, bool ext) {
+    for (uint8_t i = 0; i < macro_held_count; i++) {
+        if (macro_held[i].keycode == keycode && macro_held[i].ext == ext) {
+            macro_held[i] = macro_held[--macro_held_count];
             return;
         }
-        if (eeprom_read_byte(p) == 0) {
-            --id;
+    }
+}
+
+static void macro_held_forget(void) {
+    macro_held_count    = 0;
+    macro_held_overflow = false;
+}
+
+static void macro_held_release(void) {
+    if (macro_held_overflow) {
+        clear_keyboard();
+    } else {
+        while (macro_held_count) {
+            const macro_held_key_t *key = &macro_held[--macro_held_count];
+            if (key->ext) {
+                vial_keycode_up(key->keycode);
+            } else {
+                unregister_code(key->keycode);
+            }
+        }
+    }
+    macro_held_forget();
+}
+#else
+#    define macro_held_down(keycode, ext)
+#    define macro_held_up(keycode, ext)
+#endif
+
+#ifdef DYNAMIC_KEYMAP_MACRO_BYTECODE_ENABLE
+static void dynamic_keymap_macro_run(const macro_op_t *op) {
+    switch (op->op) {
+        case MACRO_OP_TAP:
+            tap_code(op->value);
+            amk_report_delay(TAP_CODE_DELAY);
+            break;
+        case MACRO_OP_DOWN:
+            register_code(op->value);
+            macro_held_down(op->value, false);
+            amk_report_delay(TAP_CODE_DELAY);
+            break;
+        case MACRO_OP_UP:
+            unregister_code(op->value);
+            macro_held_up(op->value, false);
+            amk_report_delay(TAP_CODE_DELAY);
+            break;
+        case MACRO_OP_DELAY:
+#    if defined(NRF52) || defined(NRF52840_XXAA)
+            nrf_usb_send_report(NRF_REPORT_ID_DELAY, &op->value, sizeof(op->value));
+#    else
+            amk_report_delay(op->value);
+#    endif
+            break;
+        case MACRO_OP_EXT_TAP:
+            vial_keycode_tap(op->value);
+            break;
+        case MACRO_OP_EXT_DOWN:
+            vial_keycode_down(op->value);
+            macro_held_down(op->value, true);
+            break;
+        case MACRO_OP_EXT_UP:
+            vial_keycode_up(op->value);
+            macro_held_up(op->value, true);
+            break;
+        default:
+            send_char_with_delay(op->op, DYNAMIC_KEYMAP_MACRO_DELAY);
+            break;
+    }
+}
+
+// Plays the next op of the macro, false at its end
+static bool dynamic_keymap_macro_step(uint16_t *offset) {
+    macro_op_t op = {0};
+    if (*offset & MACRO_OFFSET_STORED) {
+        // validated when it was written, so the decoding cannot fail
+        macro_reader_t reader = {.offset = *offset & ~MACRO_OFFSET_STORED, .limit = MACRO_READER_ACTION};
+        if (macro_decode(&reader, &op) != MACRO_DECODE_OP) {
+            return false;
+        }
+        *offset = MACRO_OFFSET_STORED | macro_reader_tell(&reader);
+    } else {
+        const uint8_t *code = &macro_bytecode[*offset];
+        uint8_t        size = macro_op_size(code[0]);
+        if (code[0] == MACRO_OP_END) {
+            return false;
         }
-        ++p;
+        op.op = code[0];
+        if (size > 1) {
+            op.value = code[1];
+        }
+        if (size > 2) {
+            op.value |= code[2] << 8;
+        }
+        *offset += size;
     }
 
+    dynamic_keymap_macro_run(&op);
+    return true;
+}
+#else
+// Plays the next char or action of the macro, false at its end
+static bool dynamic_keymap_macro_step(uint16_t *offset) {
+    void *p = (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR + *offset);
+
     // Send the macro string one or three chars at a time
     // by making temporary 1 or 3 char strings
     char data[4] = {0, 0, 0, 0};
     // We already checked there was a null at the end of
     // the buffer, so this cannot go past the end
-    while (1) {
-        memset(data, 0, sizeof(data));
-        data[0] = eeprom_read_byte(p++);
-        // Stop at the null terminator of this macro string
-        if (data[0] == 0) {
+    data[0] = dynamic_keymap_storage_read_byte(p++);
+    // Stop at the null terminator of this macro string
+    if (data[0] == 0) {
+        return false;
+    }
+    if (data[0] == SS_QMK_PREFIX) {
+        // If the char is magic, process it as indicated by the next character
+        // (tap, down, up, delay)
+        data[1] = dynamic_keymap_storage_read_byte(p++);
+        if (data[1] == 0)
+            return false;
+        if (data[1] == SS_TAP_CODE || data[1] == SS_DOWN_CODE || data[1] == SS_UP_CODE) {
+            // For tap, down, up, just stuff it into the array and send_string it
+            data[2] = dynamic_keymap_storage_read_byte(p++);
+            if (data[2] != 0) {
+                send_string(data);
+                if (data[1] == SS_DOWN_CODE) {
+                    macro_held_down((uint8_t)data[2], false);
+                } else if (data[1] == SS_UP_CODE) {
+                    macro_held_up((uint8_t)data[2], false);
+                }
+            }
+        } else if (data[1] == VIAL_MACRO_EXT_TAP || data[1] == VIAL_MACRO_EXT_DOWN || data[1] == VIAL_MACRO_EXT_UP) {
+            data[2] = dynamic_keymap_storage_read_byte(p++);
+            if (data[2] != 0) {
+                data[3] = dynamic_keymap_storage_read_byte(p++);
+                if (data[3] != 0) {
+                    uint16_t kc;
+                    memcpy(&kc, &data[2], sizeof(kc));
+                    kc = decode_keycode(kc);
+                    switch (data[1]) {
+                    case VIAL_MACRO_EXT_TAP:
+                        vial_keycode_tap(kc);
+                        break;
+                    case VIAL_MACRO_EXT_DOWN:
+                        vial_keycode_down(kc);
+                        macro_held_down(kc, true);
+                        break;
+                    case VIAL_MACRO_EXT_UP:
+                        vial_keycode_up(kc);
+                        macro_held_up(kc, true);
+                        break;
+                    }
+                }
+            }
+        } else if (data[1] == SS_DELAY_CODE) {
+            // For delay, decode the delay and wait_ms for that amount
+            uint8_t d0 = dynamic_keymap_storage_read_byte(p++);
+            uint8_t d1 = dynamic_keymap_storage_read_byte(p++);
+            if (d0 == 0 || d1 == 0)
+                return false;
+            // we cannot use 0 for these, need to subtract 1 and use 255 instead of 256 for delay calculation
+            int ms = (d0 - 1) + (d1 - 1) * 255;
+            //while (ms--) wait_ms(1);
+
+            uint16_t delay = (uint16_t)ms;
+            #if defined(NRF52) || defined(NRF52840_XXAA)
+            nrf_usb_send_report(NRF_REPORT_ID_DELAY, &delay, sizeof(delay));
+            #else
+            amk_report_delay(delay);
+            #endif
+        }
+    } else {
+        // If the char wasn't magic, just send it
+        send_string_with_delay(data, DYNAMIC_KEYMAP_MACRO_DELAY);
+    }
+
+    *offset = (uint16_t)(p - (void *)(DYNAMIC_KEYMAP_MACRO_EEPROM_ADDR));
+    return true;
+}
+
+#endif
+
+#ifdef DYNAMIC_KEYMAP_MACRO_ASYNC_ENABLE
+// macro chars or actions played per keyboard_task()
+#    ifndef DYNAMIC_KEYMAP_MACRO_STEPS
+#        define DYNAMIC_KEYMAP_MACRO_STEPS 4
+#    endif
+// macros waiting for the one playing
+#    ifndef DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE
+#        define DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE 4
+#    endif
+// pause playing while this many reports wait for their delay
+#    ifndef DYNAMIC_KEYMAP_MACRO_REPORT_LIMIT
+#        define DYNAMIC_KEYMAP_MACRO_REPORT_LIMIT 8
+#    endif
+
+/*
+ * Macros are played a few steps per keyboard_task() instead of all at
+ * once, so the matrix keeps being scanned while a long macro is typed.
+ * With REPORT_SCHEDULER_ENABLE playing also waits for the queued reports
+ * to drain, with HOST_REPORT_QUEUE_ENABLE for a full keyboard queue. With DYNAMIC_KEYMAP_MACRO_CANCEL_ON_KEYPRESS any key press
+ * stops the macro and drops the waiting ones, the keys the macro held down
+ * are released first.
+ */
+static uint16_t macro_offset  = 0;
+static uint8_t  macro_id      = 0;
+static bool     macro_playing = false;
+static uint8_t  macro_queue[DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE];
+static uint8_t  macro_queue_head  = 0;
+static uint8_t  macro_queue_count = 0;
+
+void dynamic_keymap_macro_send(uint8_t id) {
+    if (id >= DYNAMIC_KEYMAP_MACRO_COUNT || macro_queue_count == DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE) {
+        return;
+    }
+
+    macro_queue[(macro_queue_head + macro_queue_count) % DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE] = id;
+    macro_queue_count++;
+}
+
+void dynamic_keymap_macro_cancel(void) {
+    macro_queue_count = 0;
+    if (macro_playing) {
+        macro_playing = false;
+        macro_held_release();
+        amk_report_send(HID_REPORT_ID_MACRO_END, &macro_id, sizeof(macro_id));
+    }
+}
+
+bool dynamic_keymap_macro_is_playing(void) {
+    return macro_playing || macro_queue_count;
+}
+
+// Consecutive presses or releases of the steps go out in one report
+void dynamic_keymap_macro_task(void) {
+    if (!macro_playing && !macro_queue_count) {
+        return;
+    }
+
+    report_begin();
+    for (uint8_t steps = 0; steps < DYNAMIC_KEYMAP_MACRO_STEPS; steps++) {
+#    ifdef REPORT_SCHEDULER_ENABLE
+        if (host_report_pending() >= DYNAMIC_KEYMAP_MACRO_REPORT_LIMIT) {
+            break;
+        }
+#    endif
+#    ifdef HOST_REPORT_QUEUE_ENABLE
+        if (host_queue_full(HOST_ENDPOINT_KEYBOARD)) {
             break;
         }
-        if (data[0] == SS_QMK_PREFIX) {
-            // If the char is magic, process it as indicated by the next character
-            // (tap, down, up, delay)
-            data[1] = eeprom_read_byte(p++);
-            if (data[1] == 0)
+#    endif
+        if (!macro_playing) {
+            if (!macro_queue_count) {
                 break;
-            if (data[1] == SS_TAP_CODE || data[1] == SS_DOWN_CODE || data[1] == SS_UP_CODE) {
-                // For tap, down, up, just stuff it into the array and send_string it
-                data[2] = eeprom_read_byte(p++);
-                if (data[2] != 0)
-                    send_string(data);
-            } else if (data[1] == VIAL_MACRO_EXT_TAP || data[1] == VIAL_MACRO_EXT_DOWN || data[1] == VIAL_MACRO_EXT_UP) {
-                data[2] = eeprom_read_byte(p++);
-                if (data[2] != 0) {
-                    data[3] = eeprom_read_byte(p++);
-                    if (data[3] != 0) {
-                        uint16_t kc;
-                        memcpy(&kc, &data[2], sizeof(kc));
-                        kc = decode_keycode(kc);
-                        switch (data[1]) {
-                        case VIAL_MACRO_EXT_TAP:
-                            vial_keycode_tap(kc);
-                            break;
-                        case VIAL_MACRO_EXT_DOWN:
-                            vial_keycode_down(kc);
-                            break;
-                        case VIAL_MACRO_EXT_UP:
-                            vial_keycode_up(kc);
-                            break;
-                        }
-                    }
-                }
-            } else if (data[1] == SS_DELAY_CODE) {
-                // For delay, decode the delay and wait_ms for that amount
-                uint8_t d0 = eeprom_read_byte(p++);
-                uint8_t d1 = eeprom_read_byte(p++);
-                if (d0 == 0 || d1 == 0)
-                    break;
-                // we cannot use 0 for these, need to subtract 1 and use 255 instead of 256 for delay calculation
-                int ms = (d0 - 1) + (d1 - 1) * 255;
-                //while (ms--) wait_ms(1);
-
-                uint16_t delay = (uint16_t)ms;
-                #if defined(NRF52) || defined(NRF52840_XXAA)
-                nrf_usb_send_report(NRF_REPORT_ID_DELAY, &delay, sizeof(delay));
-                #else
-                usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
-                #endif
             }
-        } else {
-            // If the char wasn't magic, just send it
-            send_string_with_delay(data, DYNAMIC_KEYMAP_MACRO_DELAY);
+
+            macro_id         = macro_queue[macro_queue_head];
+            macro_queue_head = (macro_queue_head + 1) % DYNAMIC_KEYMAP_MACRO_QUEUE_SIZE;
+            macro_queue_count--;
+            if (!dynamic_keymap_macro_find(macro_id, &macro_offset)) {
+                continue;
+            }
+
+            macro_playing = true;
+            macro_held_forget();
+            amk_report_send(HID_REPORT_ID_MACRO_BEGIN, &macro_id, sizeof(macro_id));
+        }
+
+        if (!dynamic_keymap_macro_step(&macro_offset)) {
+            macro_playing = false;
+            amk_report_send(HID_REPORT_ID_MACRO_END, &macro_id, sizeof(macro_id));
         }
     }
-    usb_send_report(HID_REPORT_ID_MACRO_END, &id, sizeof(id));
+    report_commit();
 }
+#else
+void dynamic_keymap_macro_send(uint8_t id) {
+    if (id >= DYNAMIC_KEYMAP_MACRO_COUNT) {
+        return;
+    }
+
+    uint16_t offset;
+    if (!dynamic_keymap_macro_find(id, &offset)) {
+        return;
+    }
+
+    // Consecutive presses or releases of the steps go out in one report
+    amk_report_send(HID_REPORT_ID_MACRO_BEGIN, &id, sizeof(id));
+    report_begin();
+    while (dynamic_keymap_macro_step(&offset))
+        ;
+    report_commit();
+    amk_report_send(HID_REPORT_ID_MACRO_END, &id, sizeof(id));
+}
+
+void dynamic_keymap_macro_cancel(void) {}
+
+bool dynamic_keymap_macro_is_playing(void) {
+    return false;
+}
+#endif
@@ -0,0 +1,29 @@
+/**
+ * @file dynamic_keymap.h
+ * @author astro
+ *  additions to the quantum dynamic_keymap.h for protocol/dynamic_keymap.c
+ *
+ * Takes the place of the quantum header and pulls it in with include_next,
+ * so protocol/ has to stay in front of quantum/ in the include path.
+ */
+
+#pragma once
+
+#include_next "dynamic_keymap.h"
+
+/* fill the RAM mirror of the keymap from the storage, once at startup */
+void dynamic_keymap_cache_init(void);
+
+/* build the macro index from the storage, once at startup */
+void dynamic_keymap_macro_init(void);
+/* macros the last write of the macro buffer left rejected as malformed */
+uint8_t dynamic_keymap_macro_rejected(void);
+/* play the pending macro steps, call from the main loop */
+void dynamic_keymap_macro_task(void);
+/* stop the macro playing */
+void dynamic_keymap_macro_cancel(void);
+/* a macro is playing or queued, always false without async playback */
+bool dynamic_keymap_macro_is_playing(void);
+
+/* called once after dynamic_keymap_reset() rewrote the whole keymap, weak */
+void dynamic_keymap_reset_kb(void);
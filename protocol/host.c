@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 #include "keyboard.h"
 #include "keycode.h"
 #include "host.h"
@@ -44,6 +45,675 @@ static host_driver_t *driver;
 static uint16_t       last_system_usage   = 0;
 static uint16_t       last_consumer_usage = 0;
 
+enum {
+    HOST_REPORT_KEYBOARD,
+    HOST_REPORT_NKRO,
+    HOST_REPORT_MOUSE,
+    HOST_REPORT_EXTRA,
+    HOST_REPORT_RAW,
+    HOST_REPORT_RAW_HID,
+};
+
+static void host_driver_send(uint8_t type, const void *report, uint8_t size) {
+    switch (type) {
+        case HOST_REPORT_KEYBOARD:
+            (*driver->send_keyboard)((report_keyboard_t *)report);
+            break;
+        case HOST_REPORT_NKRO:
+            (*driver->send_nkro)((report_nkro_t *)report);
+            break;
+        case HOST_REPORT_MOUSE:
+            (*driver->send_mouse)((report_mouse_t *)report);
+            break;
+        case HOST_REPORT_EXTRA:
+            (*driver->send_extra)((report_extra_t *)report);
+            break;
+        default:
+            return;
+    }
+    keystroke_cost_report_sent();
+}
+
+static bool keyboard_report_has_key(const report_keyboard_t *report, uint8_t key) {
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// true if the keyboard or nkro report to has a key or mod pressed which from has not
+static bool host_report_presses(uint8_t type, const void *from, const void *to) {
+    if (type == HOST_REPORT_NKRO) {
+        const report_nkro_t *f = from;
+        const report_nkro_t *t = to;
+        if (t->mods & ~f->mods) {
+            return true;
+        }
+        for (uint8_t i = 0; i < NKRO_REPORT_BITS; i++) {
+            if (t->bits[i] & ~f->bits[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const report_keyboard_t *f = from;
+    const report_keyboard_t *t = to;
+    if (t->mods & ~f->mods) {
+        return true;
+    }
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (t->keys[i] && !keyboard_report_has_key(f, t->keys[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// sent, pending, next can go out as sent, next if they only press or only release
+static bool host_report_monotonic(uint8_t type, const void *sent, const void *pending, const void *next) {
+    bool presses  = host_report_presses(type, sent, pending) || host_report_presses(type, pending, next);
+    bool releases = host_report_presses(type, pending, sent) || host_report_presses(type, next, pending);
+    return !(presses && releases);
+}
+
+#ifdef HOST_REPORT_QUEUE_ENABLE
+#    include "timer.h"
+
+#    ifndef HOST_REPORT_QUEUE_SIZE
+#        define HOST_REPORT_QUEUE_SIZE 8
+#    endif
+#    ifndef HOST_REPORT_QUEUE_RAW_SIZE
+#        define HOST_REPORT_QUEUE_RAW_SIZE 32
+#    endif
+_Static_assert((HOST_REPORT_QUEUE_SIZE & (HOST_REPORT_QUEUE_SIZE - 1)) == 0 && HOST_REPORT_QUEUE_SIZE <= 128, "HOST_REPORT_QUEUE_SIZE must be a power of 2, at most 128");
+
+/*
+ * Every endpoint has a single producer/single consumer ring between the
+ * report functions here and host_queue_drain(), which runs in the main loop
+ * or, with HOST_REPORT_QUEUE_ISR, only in the usb interrupt. The consumer
+ * sends while host_endpoint_ready() says the endpoint takes a report.
+ *
+ * A report for an empty ring is published at once. Behind others it is
+ * held on the producer side, where a newer state may replace it: keyboard
+ * and nkro states if the keys only go one way, mouse reports with the same
+ * buttons by adding up the motion, repeated extra reports. The held report
+ * is published when the ring empties or the next one does not merge. Raw
+ * hid reports are never merged.
+ *
+ * Pushing never waits. A report which neither merges nor finds room is
+ * parked behind the held one and host_queue_full() tells the producers to
+ * hold off until host_queue_task() moves both on. Only a producer ignoring
+ * that can lose a report: a newer state replaces the parked one, which is
+ * counted as dropped when it had keys or buttons going the other way.
+ */
+typedef struct {
+    uint16_t time;
+    uint8_t  type;
+    uint8_t  size;
+    union {
+        report_keyboard_t keyboard;
+        report_nkro_t     nkro;
+        report_mouse_t    mouse;
+        report_extra_t    extra;
+        uint8_t           raw[HOST_REPORT_QUEUE_RAW_SIZE];
+    };
+} host_queue_entry_t;
+
+typedef struct {
+    host_queue_entry_t entries[HOST_REPORT_QUEUE_SIZE];
+    uint8_t            head;
+    uint8_t            tail;
+    // producer side, the report held back, the one parked behind it
+    // while the ring is full and the last one published
+    bool               held;
+    bool               parked;
+    host_queue_entry_t hold;
+    host_queue_entry_t park;
+    host_queue_entry_t last;
+    host_queue_stats_t stats;
+} host_queue_t;
+
+static host_queue_t host_queues[HOST_ENDPOINT_COUNT];
+
+__attribute__((weak)) bool host_endpoint_ready(uint8_t endpoint) {
+    return true;
+}
+
+__attribute__((weak)) void host_raw_endpoint_send(const uint8_t *data, uint8_t length) {}
+
+static uint8_t host_report_endpoint(uint8_t type) {
+    switch (type) {
+        case HOST_REPORT_MOUSE:
+            return HOST_ENDPOINT_MOUSE;
+        case HOST_REPORT_EXTRA:
+            return HOST_ENDPOINT_EXTRA;
+        case HOST_REPORT_RAW_HID:
+            return HOST_ENDPOINT_RAW;
+        default:
+            return HOST_ENDPOINT_KEYBOARD;
+    }
+}
+
+// merges next into into, which goes out after base
+static bool host_queue_merge(host_queue_entry_t *into, const host_queue_entry_t *base, const host_queue_entry_t *next) {
+    if (into->type != next->type) {
+        return false;
+    }
+
+    switch (next->type) {
+        case HOST_REPORT_KEYBOARD:
+        case HOST_REPORT_NKRO:
+            if (!host_report_monotonic(next->type, base->raw, into->raw, next->raw)) {
+                return false;
+            }
+            break;
+        case HOST_REPORT_MOUSE: {
+            const int32_t xy_max = sizeof(mouse_xy_report_t) == 1 ? 127 : 32767;
+            int32_t       x      = into->mouse.x + next->mouse.x;
+            int32_t       y      = into->mouse.y + next->mouse.y;
+            int16_t       v      = into->mouse.v + next->mouse.v;
+            int16_t       h      = into->mouse.h + next->mouse.h;
+            if (into->mouse.buttons != next->mouse.buttons || x < -xy_max || x > xy_max || y < -xy_max || y > xy_max || v < -127 || v > 127 || h < -127 || h > 127) {
+                return false;
+            }
+            into->mouse.x = x;
+            into->mouse.y = y;
+            into->mouse.v = v;
+            into->mouse.h = h;
+#    ifdef MOUSE_EXTENDED_REPORT
+            into->mouse.boot_x = x > 127 ? 127 : (x < -127 ? -127 : x);
+            into->mouse.boot_y = y > 127 ? 127 : (y < -127 ? -127 : y);
+#    endif
+            return true;
+        }
+        case HOST_REPORT_EXTRA:
+            if (memcmp(&into->extra, &next->extra, sizeof(report_extra_t))) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    memcpy(into->raw, next->raw, next->size);
+    return true;
+}
+
+static uint8_t host_queue_used(host_queue_t *queue) {
+    return queue->head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
+
+static void host_queue_publish(host_queue_t *queue, const host_queue_entry_t *entry) {
+    queue->entries[queue->head % HOST_REPORT_QUEUE_SIZE] = *entry;
+    __atomic_store_n(&queue->head, (uint8_t)(queue->head + 1), __ATOMIC_RELEASE);
+    queue->last = *entry;
+
+    uint8_t used = host_queue_used(queue);
+    if (used > queue->stats.high_water) {
+        queue->stats.high_water = used;
+    }
+}
+
+// publishes the held report if the ring has room and moves the parked one up
+static void host_queue_advance(host_queue_t *queue) {
+    if (!queue->held || host_queue_used(queue) == HOST_REPORT_QUEUE_SIZE) {
+        return;
+    }
+
+    host_queue_publish(queue, &queue->hold);
+    queue->held = queue->parked;
+    if (queue->parked) {
+        queue->hold   = queue->park;
+        queue->parked = false;
+    }
+}
+
+static void host_queue_push(uint8_t type, const void *report, uint8_t size) {
+    host_queue_t      *queue = &host_queues[host_report_endpoint(type)];
+    host_queue_entry_t entry;
+    if (size > sizeof(entry.raw)) {
+        queue->stats.dropped++;
+        return;
+    }
+    entry.time = timer_read();
+    entry.type = type;
+    entry.size = size;
+    memcpy(entry.raw, report, size);
+    queue->stats.queued++;
+
+    if (queue->parked) {
+        if (host_queue_merge(&queue->park, &queue->hold, &entry)) {
+            queue->stats.coalesced++;
+            return;
+        }
+        // the producer did not hold off, a newer state still replaces the parked one
+        queue->stats.dropped++;
+        if (type != HOST_REPORT_RAW_HID) {
+            queue->park = entry;
+        }
+        return;
+    }
+
+    if (queue->held) {
+        if (host_queue_merge(&queue->hold, &queue->last, &entry)) {
+            queue->stats.coalesced++;
+            return;
+        }
+
+        host_queue_advance(queue);
+        if (queue->held) {
+            queue->park   = entry;
+            queue->parked = true;
+            queue->stats.parked++;
+            return;
+        }
+    }
+
+    if (host_queue_used(queue) == 0) {
+        host_queue_publish(queue, &entry);
+    } else {
+        queue->hold = entry;
+        queue->held = true;
+    }
+}
+
+bool host_queue_full(uint8_t endpoint) {
+    return endpoint < HOST_ENDPOINT_COUNT && host_queues[endpoint].parked;
+}
+
+void host_queue_task(void) {
+#    ifndef HOST_REPORT_QUEUE_ISR
+    host_queue_drain();
+#    endif
+    for (uint8_t endpoint = 0; endpoint < HOST_ENDPOINT_COUNT; endpoint++) {
+        host_queue_t *queue = &host_queues[endpoint];
+        if (queue->parked) {
+            host_queue_advance(queue);
+        }
+        if (queue->held && host_queue_used(queue) == 0) {
+            host_queue_advance(queue);
+        }
+    }
+#    ifndef HOST_REPORT_QUEUE_ISR
+    host_queue_drain();
+#    endif
+}
+
+void host_queue_drain(void) {
+    for (uint8_t endpoint = 0; endpoint < HOST_ENDPOINT_COUNT; endpoint++) {
+        host_queue_t *queue = &host_queues[endpoint];
+        uint8_t       tail  = queue->tail;
+        while (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) && host_endpoint_ready(endpoint)) {
+            const host_queue_entry_t *entry = &queue->entries[tail % HOST_REPORT_QUEUE_SIZE];
+            if (entry->type == HOST_REPORT_RAW_HID) {
+                host_raw_endpoint_send(entry->raw, entry->size);
+            } else if (driver) {
+                host_driver_send(entry->type, entry->raw, entry->size);
+            }
+
+            uint16_t residency = timer_elapsed(entry->time);
+            queue->stats.sent++;
+            queue->stats.residency_total += residency;
+            if (residency > queue->stats.residency_max) {
+                queue->stats.residency_max = residency;
+            }
+            __atomic_store_n(&queue->tail, ++tail, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+void host_raw_send(const uint8_t *data, uint8_t length) {
+    host_queue_push(HOST_REPORT_RAW_HID, data, length);
+}
+
+void host_queue_get_stats(uint8_t endpoint, host_queue_stats_t *stats) {
+    if (endpoint < HOST_ENDPOINT_COUNT) {
+        *stats = host_queues[endpoint].stats;
+    }
+}
+
+#    define host_report_submit(type, report, size) host_queue_push(type, report, size)
+#else
+#    define host_report_submit(type, report, size) host_driver_send(type, report, size)
+#endif
+
+#ifdef REPORT_SCHEDULER_ENABLE
+#    include "timer.h"
+#    include "usb_interface.h"
+
+#    ifndef REPORT_SCHEDULER_SIZE
+#        define REPORT_SCHEDULER_SIZE 16
+#    endif
+#    ifndef REPORT_SCHEDULER_RAW_SIZE
+#        define REPORT_SCHEDULER_RAW_SIZE 8
+#    endif
+_Static_assert(REPORT_SCHEDULER_SIZE > 0 && REPORT_SCHEDULER_SIZE <= 255, "REPORT_SCHEDULER_SIZE must be 1..255");
+
+/*
+ * Reports sent after a delay are queued with the time they are due and
+ * released by host_report_task(). The delays themselves only move the
+ * release cursor, so back to back delays merge and take no queue slot.
+ * Without a pending delay reports go straight to the driver. A full queue
+ * never blocks the sender: its oldest report goes out ahead of its delay,
+ * which keeps the order and every edge but shortens that one delay.
+ * Senders which can pace themselves, like the macro player, keep
+ * host_report_pending() below REPORT_SCHEDULER_SIZE instead.
+ */
+typedef struct {
+    uint16_t release;
+    uint8_t  type;
+    uint8_t  size;
+    union {
+        report_keyboard_t keyboard;
+        report_nkro_t     nkro;
+        report_mouse_t    mouse;
+        report_extra_t    extra;
+        uint8_t           raw[REPORT_SCHEDULER_RAW_SIZE];
+    };
+} host_scheduled_report_t;
+
+static host_scheduled_report_t report_queue[REPORT_SCHEDULER_SIZE];
+static uint8_t                 report_queue_head   = 0;
+static uint8_t                 report_queue_count  = 0;
+static bool                    report_cursor_armed = false;
+static uint16_t                report_cursor       = 0;
+static host_report_stats_t     report_stats;
+
+static bool host_report_due(uint16_t now, uint16_t release) {
+    return TIMER_DIFF_16(now, release) < 0x8000;
+}
+
+static void host_report_dispatch(uint8_t type, const void *report, uint8_t size) {
+    if (type == HOST_REPORT_RAW) {
+        // raw reports carry their usb report type in the first byte
+        usb_send_report(((const uint8_t *)report)[0], (const uint8_t *)report + 1, size);
+    } else if (driver) {
+        host_report_submit(type, report, size);
+    }
+}
+
+static void host_report_release(void) {
+    const host_scheduled_report_t *entry = &report_queue[report_queue_head];
+    host_report_dispatch(entry->type, entry->raw, entry->size);
+    report_queue_head = (report_queue_head + 1) % REPORT_SCHEDULER_SIZE;
+    report_queue_count--;
+}
+
+void host_report_task(void) {
+    const uint16_t now = timer_read();
+    while (report_queue_count && host_report_due(now, report_queue[report_queue_head].release)) {
+        host_report_release();
+    }
+
+    if (!report_queue_count && report_cursor_armed && host_report_due(now, report_cursor)) {
+        report_cursor_armed = false;
+    }
+}
+
+void host_report_delay(uint16_t delay) {
+    if (!delay) {
+        return;
+    }
+
+    // the staged keyboard state goes out before the delay
+    host_report_flush();
+
+    if (!report_cursor_armed) {
+        report_cursor       = timer_read();
+        report_cursor_armed = true;
+    }
+    report_cursor += delay;
+    report_stats.delays++;
+}
+
+static void host_report_schedule(uint8_t type, const void *report, uint8_t size) {
+    host_report_task();
+    if (report_cursor_armed && report_queue_count == REPORT_SCHEDULER_SIZE) {
+        report_stats.early++;
+        host_report_release();
+    }
+
+    if (!report_cursor_armed) {
+        host_report_dispatch(type, report, size);
+        return;
+    }
+
+    host_scheduled_report_t *entry = &report_queue[(report_queue_head + report_queue_count) % REPORT_SCHEDULER_SIZE];
+    entry->release                 = report_cursor;
+    entry->type                    = type;
+    entry->size                    = size;
+    memcpy(entry->raw, report, type == HOST_REPORT_RAW ? size + 1 : size);
+    report_queue_count++;
+
+    report_stats.queued++;
+    if (report_queue_count > report_stats.high_water) {
+        report_stats.high_water = report_queue_count;
+    }
+}
+
+void host_report_raw(uint8_t type, const void *data, uint8_t size) {
+    uint8_t raw[REPORT_SCHEDULER_RAW_SIZE];
+    if (size >= sizeof(raw)) {
+        return;
+    }
+    host_report_flush();
+    raw[0] = type;
+    memcpy(&raw[1], data, size);
+    host_report_schedule(HOST_REPORT_RAW, raw, size);
+}
+
+uint8_t host_report_pending(void) {
+    return report_queue_count;
+}
+
+void host_report_get_stats(host_report_stats_t *stats) {
+    *stats          = report_stats;
+    stats->occupied = report_queue_count;
+}
+#else
+#    define host_report_schedule(type, report, size) host_report_submit(type, report, size)
+#endif
+
+/*
+ * Keyboard reports are staged before they go to the host. A new state only
+ * replaces the staged one if the host could not tell the difference, i.e.
+ * the keys and mods were only pressed or only released since the last
+ * report sent. Otherwise, e.g. the forced release of an already pressed
+ * key in register_code() or a tap, the staged report is sent first. Any
+ * other report or delay sends the staged one before it.
+ *
+ * Between report_begin() and report_commit() the changes are merged that
+ * way and sent at the commit, so a modifier and a key go out in one report.
+ *
+ * With HOST_REPORT_COMMIT_ENABLE host_report_commit_task() sends the final
+ * state at most once per HOST_REPORT_COMMIT_INTERVAL, so a chord processed
+ * in one scan goes out as one report. Without it the state is sent right
+ * away outside of a transaction.
+ */
+typedef union {
+    report_keyboard_t keyboard;
+    report_nkro_t     nkro;
+} host_commit_report_t;
+
+static host_commit_report_t commit_sent;
+static host_commit_report_t commit_pending;
+static uint8_t              commit_type        = HOST_REPORT_KEYBOARD;
+static bool                 commit_dirty       = false;
+static uint8_t              report_transaction = 0;
+
+#ifdef HOST_REPORT_COMMIT_ENABLE
+#    include "timer.h"
+
+#    ifndef HOST_REPORT_COMMIT_INTERVAL
+#        ifdef USB_POLLING_INTERVAL_MS
+#            define HOST_REPORT_COMMIT_INTERVAL USB_POLLING_INTERVAL_MS
+#        else
+#            define HOST_REPORT_COMMIT_INTERVAL 1
+#        endif
+#    endif
+
+static uint16_t commit_last = 0;
+#endif
+
+static bool host_report_mergeable(const host_commit_report_t *next) {
+    return host_report_monotonic(commit_type, &commit_sent, &commit_pending, next);
+}
+
+void host_report_flush(void) {
+    if (!commit_dirty) {
+        return;
+    }
+
+    commit_dirty = false;
+    commit_sent  = commit_pending;
+#ifdef HOST_REPORT_COMMIT_ENABLE
+    commit_last = timer_read();
+#endif
+    host_report_schedule(commit_type, &commit_sent, commit_type == HOST_REPORT_NKRO ? sizeof(report_nkro_t) : sizeof(report_keyboard_t));
+}
+
+static void host_report_stage(uint8_t type, const void *report, uint8_t size) {
+    host_commit_report_t next;
+    memcpy(&next, report, size);
+
+    if (commit_dirty && (type != commit_type || !host_report_mergeable(&next))) {
+        host_report_flush();
+    }
+    if (type != commit_type) {
+        // the protocol changed, nothing to compare against
+        commit_type = type;
+        memset(&commit_sent, 0, sizeof(commit_sent));
+    }
+
+    commit_pending = next;
+    commit_dirty   = true;
+#ifndef HOST_REPORT_COMMIT_ENABLE
+    if (!report_transaction) {
+        host_report_flush();
+    }
+#endif
+}
+
+void report_begin(void) {
+    report_transaction++;
+}
+
+void report_commit(void) {
+    if (report_transaction && !--report_transaction) {
+        host_report_flush();
+    }
+}
+
+#ifdef HOST_REPORT_COMMIT_ENABLE
+void host_report_commit_task(void) {
+    if (commit_dirty && !report_transaction && timer_elapsed(commit_last) >= HOST_REPORT_COMMIT_INTERVAL) {
+        host_report_flush();
+    }
+}
+#endif
+
+static void host_mouse_dispatch(report_mouse_t *report) {
+#ifdef MOUSE_SHARED_EP
+    report->report_id = REPORT_ID_MOUSE;
+#endif
+#ifdef MOUSE_EXTENDED_REPORT
+    // clip and copy to Boot protocol XY
+    report->boot_x = (report->x > 127) ? 127 : ((report->x < -127) ? -127 : report->x);
+    report->boot_y = (report->y > 127) ? 127 : ((report->y < -127) ? -127 : report->y);
+#endif
+    host_report_flush();
+    host_report_schedule(HOST_REPORT_MOUSE, report, sizeof(*report));
+}
+
+#ifdef HOST_MOUSE_ACCUMULATE_ENABLE
+#    include "timer.h"
+
+#    ifndef HOST_MOUSE_ACCUMULATE_INTERVAL
+#        ifdef USB_POLLING_INTERVAL_MS
+#            define HOST_MOUSE_ACCUMULATE_INTERVAL USB_POLLING_INTERVAL_MS
+#        else
+#            define HOST_MOUSE_ACCUMULATE_INTERVAL 1
+#        endif
+#    endif
+
+// button changes waiting to be reported, each with the motion sent after it
+#    ifndef HOST_MOUSE_ACCUMULATE_CHANGES
+#        define HOST_MOUSE_ACCUMULATE_CHANGES 4
+#    endif
+_Static_assert(HOST_MOUSE_ACCUMULATE_CHANGES >= 2, "HOST_MOUSE_ACCUMULATE_CHANGES must be at least 2");
+
+/*
+ * The motion of every host_mouse_send() is summed up here, whoever sends
+ * it, and host_mouse_task() sends at most one report per
+ * HOST_MOUSE_ACCUMULATE_INTERVAL. A sum beyond the report range goes out
+ * in range sized parts, the rest is carried to the next report. A button
+ * change starts a new sum behind the current one, so the order of motion
+ * and clicks stays as sent. Only when HOST_MOUSE_ACCUMULATE_CHANGES sums
+ * are waiting does a change send the oldest one at once, what it has left
+ * beyond the report range moves on to the next sum.
+ */
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t v;
+    int32_t h;
+    uint8_t buttons;
+    bool    changed; // buttons not reported yet
+} host_mouse_motion_t;
+
+// oldest first, new motion adds up in the last one
+static host_mouse_motion_t mouse_motion[HOST_MOUSE_ACCUMULATE_CHANGES];
+static uint8_t             mouse_motion_count = 1;
+static uint16_t            mouse_last         = 0;
+
+static int32_t host_mouse_take(int32_t *motion, int32_t limit) {
+    int32_t part = *motion > limit ? limit : (*motion < -limit ? -limit : *motion);
+    *motion -= part;
+    return part;
+}
+
+static bool host_mouse_pending(const host_mouse_motion_t *motion) {
+    return motion->changed || motion->x || motion->y || motion->v || motion->h;
+}
+
+// drops the oldest sum, what is left of its motion goes to the next one
+static void host_mouse_shift(void) {
+    mouse_motion[1].x += mouse_motion[0].x;
+    mouse_motion[1].y += mouse_motion[0].y;
+    mouse_motion[1].v += mouse_motion[0].v;
+    mouse_motion[1].h += mouse_motion[0].h;
+    memmove(&mouse_motion[0], &mouse_motion[1], --mouse_motion_count * sizeof(mouse_motion[0]));
+}
+
+static void host_mouse_report(void) {
+    host_mouse_motion_t *motion = &mouse_motion[0];
+    // the boot protocol only has the 8 bit fields
+    const int32_t  xy_max = sizeof(mouse_xy_report_t) == 1 || !keyboard_protocol ? 127 : 32767;
+    report_mouse_t report = {
+        .buttons = motion->buttons,
+        .x       = host_mouse_take(&motion->x, xy_max),
+        .y       = host_mouse_take(&motion->y, xy_max),
+        .v       = host_mouse_take(&motion->v, 127),
+        .h       = host_mouse_take(&motion->h, 127),
+    };
+    motion->changed = false;
+    mouse_last      = timer_read();
+    if (mouse_motion_count > 1 && !host_mouse_pending(motion)) {
+        host_mouse_shift();
+    }
+    host_mouse_dispatch(&report);
+}
+
+void host_mouse_task(void) {
+    if (driver && host_mouse_pending(&mouse_motion[0]) && timer_elapsed(mouse_last) >= HOST_MOUSE_ACCUMULATE_INTERVAL) {
+        host_mouse_report();
+    }
+}
+#endif
+
 void host_set_driver(host_driver_t *d) {
     driver = d;
 }
@@ -84,7 +754,7 @@ void host_keyboard_send(report_keyboard_t *report) {
 #ifdef KEYBOARD_SHARED_EP
     report->report_id = REPORT_ID_KEYBOARD;
 #endif
-    (*driver->send_keyboard)(report);
+    host_report_stage(HOST_REPORT_KEYBOARD, report, sizeof(*report));
 
     if (debug_keyboard) {
         dprintf("keyboard_report: %02X | ", report->mods);
@@ -98,7 +768,7 @@ void host_keyboard_send(report_keyboard_t *report) {
 void host_nkro_send(report_nkro_t *report) {
     if (!driver) return;
     report->report_id = REPORT_ID_NKRO;
-    (*driver->send_nkro)(report);
+    host_report_stage(HOST_REPORT_NKRO, report, sizeof(*report));
 
     if (debug_keyboard) {
         dprintf("nkro_report: %02X | ", report->mods);
@@ -118,15 +788,28 @@ void host_mouse_send(report_mouse_t *report) {
 #endif
 
     if (!driver) return;
-#ifdef MOUSE_SHARED_EP
-    report->report_id = REPORT_ID_MOUSE;
-#endif
-#ifdef MOUSE_EXTENDED_REPORT
-    // clip and copy to Boot protocol XY
-    report->boot_x = (report->x > 127) ? 127 : ((report->x < -127) ? -127 : report->x);
-    report->boot_y = (report->y > 127) ? 127 : ((report->y < -127) ? -127 : report->y);
+#ifdef HOST_MOUSE_ACCUMULATE_ENABLE
+    host_mouse_motion_t *motion = &mouse_motion[mouse_motion_count - 1];
+    if (report->buttons != motion->buttons) {
+        // a sum with nothing left to report is reused
+        if (host_mouse_pending(motion)) {
+            if (mouse_motion_count == HOST_MOUSE_ACCUMULATE_CHANGES) {
+                host_mouse_report();
+                if (mouse_motion_count == HOST_MOUSE_ACCUMULATE_CHANGES) {
+                    host_mouse_shift();
+                }
+            }
+            motion = &mouse_motion[mouse_motion_count++];
+        }
+        *motion = (host_mouse_motion_t){.buttons = report->buttons, .changed = true};
+    }
+    motion->x += report->x;
+    motion->y += report->y;
+    motion->v += report->v;
+    motion->h += report->h;
+#else
+    host_mouse_dispatch(report);
 #endif
-    (*driver->send_mouse)(report);
 }
 
 void host_system_send(uint16_t usage) {
@@ -139,7 +822,8 @@ void host_system_send(uint16_t usage) {
         .report_id = REPORT_ID_SYSTEM,
         .usage     = usage,
     };
-    (*driver->send_extra)(&report);
+    host_report_flush();
+    host_report_schedule(HOST_REPORT_EXTRA, &report, sizeof(report));
 }
 
 void host_consumer_send(uint16_t usage) {
@@ -159,7 +843,8 @@ void host_consumer_send(uint16_t usage) {
         .report_id = REPORT_ID_CONSUMER,
         .usage     = usage,
     };
-    (*driver->send_extra)(&report);
+    host_report_flush();
+    host_report_schedule(HOST_REPORT_EXTRA, &report, sizeof(report));
 }
 
 #ifdef JOYSTICK_ENABLE
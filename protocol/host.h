@@ -47,6 +47,79 @@ void    host_programmable_button_send(uint32_t data);
 uint16_t host_last_system_usage(void);
 uint16_t host_last_consumer_usage(void);
 
+#ifdef REPORT_SCHEDULER_ENABLE
+typedef struct {
+    uint32_t queued;     // reports held back by a delay
+    uint32_t delays;     // delays merged into the release cursor
+    uint32_t early;      // reports sent ahead of their delay by a full queue
+    uint8_t  high_water; // highest number of queued reports
+    uint8_t  occupied;   // reports queued right now
+} host_report_stats_t;
+
+/* release the reports sent after this delay milliseconds later */
+void    host_report_delay(uint16_t delay);
+/* send a raw usb report in order with the queued ones */
+void    host_report_raw(uint8_t type, const void *data, uint8_t size);
+void    host_report_task(void);
+/* reports waiting for their delay, senders pace themselves on it */
+uint8_t host_report_pending(void);
+void    host_report_get_stats(host_report_stats_t *stats);
+#endif
+
+#ifdef HOST_REPORT_QUEUE_ENABLE
+enum {
+    HOST_ENDPOINT_KEYBOARD,
+    HOST_ENDPOINT_MOUSE,
+    HOST_ENDPOINT_EXTRA,
+    HOST_ENDPOINT_RAW,
+    HOST_ENDPOINT_COUNT,
+};
+
+typedef struct {
+    uint32_t queued;          // reports handed to the queue
+    uint32_t coalesced;       // reports merged into the one held back
+    uint32_t parked;          // reports which found the queue full
+    uint32_t dropped;         // reports lost while the queue was full
+    uint32_t sent;            // reports taken by the endpoint
+    uint32_t residency_total; // milliseconds from queueing to sending, summed over sent
+    uint16_t residency_max;   // longest of them
+    uint8_t  high_water;      // highest number of queued reports
+} host_queue_stats_t;
+
+/* endpoint takes a report now, weak, true by default, see qmk_driver.c */
+bool host_endpoint_ready(uint8_t endpoint);
+/* platform send of a raw hid report, called by the consumer */
+void host_raw_endpoint_send(const uint8_t *data, uint8_t length);
+/* queue a raw hid report in order */
+void host_raw_send(const uint8_t *data, uint8_t length);
+/* a report waits for room, producers which can wait hold off until it clears */
+bool host_queue_full(uint8_t endpoint);
+/* publish held reports and, without HOST_REPORT_QUEUE_ISR, drain the queues */
+void host_queue_task(void);
+/* consumer side, send what the endpoints take, from one context only */
+void host_queue_drain(void);
+void host_queue_get_stats(uint8_t endpoint, host_queue_stats_t *stats);
+#endif
+
+/* delay the reports sent after it, see qmk_driver.c */
+void amk_report_delay(uint16_t delay);
+/* send a raw usb report in order with the keyboard reports, see qmk_driver.c */
+void amk_report_send(uint8_t type, const void *data, uint8_t size);
+
+/* send the staged keyboard report now */
+void host_report_flush(void);
+/* group keyboard report changes, the merged state is sent at the outermost commit */
+void report_begin(void);
+void report_commit(void);
+#ifdef HOST_REPORT_COMMIT_ENABLE
+/* send the staged keyboard report once per polling interval, call last in the main loop */
+void host_report_commit_task(void);
+#endif
+#ifdef HOST_MOUSE_ACCUMULATE_ENABLE
+/* send the mouse motion summed up since the last report, call last in the main loop */
+void host_mouse_task(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,36 @@
+/**
+ * @file key_event_queue.h
+ * @author astro
+ *  single producer/single consumer queue between matrix scanning and key processing
+ *
+ * With KEY_EVENT_QUEUE_ENABLE the matrix scan only pushes the key events
+ * into a bounded ring, keyboard_task() drains it into action_exec(). A slow
+ * action chain then no longer delays the next scan.
+ *
+ * With KEY_EVENT_QUEUE_EXTERNAL_SCAN keyboard_task() does not scan at all,
+ * the platform calls keyboard_scan_task() from a timer interrupt or another
+ * loop instead. Only that one context may scan. It only runs the raw scan
+ * and the debounce, through matrix_scan_isr(), then queues the changes.
+ * The matrix_scan_kb() hooks, the matrix debug output and the keymap reads
+ * of the ghost detection stay in keyboard_task().
+ *
+ * A change which does not fit into a full ring is not lost, it stays
+ * pending in the matrix and is pushed again by the next scan.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* scan the matrix and queue its changes, returns true if the matrix changed */
+bool keyboard_scan_task(void);
+#ifdef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+/* raw scan and debounce of the matrix, weak, for CUSTOM_MATRIX = lite by default */
+bool matrix_scan_isr(void);
+#endif
+
+/* number of pushes rejected because the ring was full */
+uint32_t key_event_queue_overflows(void);
+/* highest number of queued events seen */
+uint8_t key_event_queue_high_water(void);
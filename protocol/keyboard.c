@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 #include "keyboard.h"
 #include "keycode_config.h"
 #include "matrix.h"
@@ -146,6 +147,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef OS_DETECTION_ENABLE
 #    include "os_detection.h"
 #endif
+#ifdef DEADLINE_TICK_ENABLE
+#    include "tick_deadline.h"
+#    include "action_tapping.h"
+#    include "action_util.h"
+#    include "qmk_settings.h"
+#endif
+#ifdef KEY_EVENT_QUEUE_ENABLE
+#    include "key_event_queue.h"
+#endif
+#ifdef DYNAMIC_KEYMAP_ENABLE
+#    include "dynamic_keymap.h"
+#endif
+#ifdef LOG_STORE_ENABLE
+#    include "log_store.h"
+#endif
 
 static uint32_t last_input_modification_time = 0;
 uint32_t        last_input_activity_time(void) {
@@ -222,17 +238,109 @@ uint32_t get_matrix_scan_rate(void) {
 #    define matrix_scan_perf_task()
 #endif
 
+#if defined(DEBUG_KEYSTROKE_COST)
+#    ifndef KEYSTROKE_COST_SAMPLES
+#        define KEYSTROKE_COST_SAMPLES 128
+#    endif
+_Static_assert(KEYSTROKE_COST_SAMPLES > 0 && KEYSTROKE_COST_SAMPLES <= 255, "KEYSTROKE_COST_SAMPLES must be 1..255");
+
+/*
+ * Per key event: keystroke_cost_clock() ticks spent in action_exec(), the
+ * reports sent meanwhile and the milliseconds since the physical edge.
+ * Printed as p50/p99 every KEYSTROKE_COST_SAMPLES key events. The default
+ * clock counts milliseconds, override it with a cycle counter.
+ */
+static uint32_t keystroke_costs[KEYSTROKE_COST_SAMPLES];
+static uint32_t keystroke_latencies[KEYSTROKE_COST_SAMPLES];
+static uint32_t keystroke_reports = 0;
+static uint8_t  keystroke_count   = 0;
+
+__attribute__((weak)) uint32_t keystroke_cost_clock(void) {
+    return timer_read32();
+}
+
+void keystroke_cost_report_sent(void) {
+    keystroke_reports++;
+}
+
+static uint32_t keystroke_cost_percentile(uint32_t *samples, uint8_t percent) {
+    // insertion sort, the samples are discarded after printing
+    for (uint8_t i = 1; i < KEYSTROKE_COST_SAMPLES; i++) {
+        uint32_t value = samples[i];
+        uint8_t  j     = i;
+        for (; j > 0 && samples[j - 1] > value; j--) {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = value;
+    }
+    return samples[(KEYSTROKE_COST_SAMPLES - 1) * percent / 100];
+}
+
+static void keystroke_cost_exec(keyevent_t event) {
+    const uint32_t start = keystroke_cost_clock();
+    action_exec(event);
+    keystroke_costs[keystroke_count]     = keystroke_cost_clock() - start;
+    keystroke_latencies[keystroke_count] = TIMER_DIFF_16(timer_read(), event.time);
+
+    if (++keystroke_count < KEYSTROKE_COST_SAMPLES) {
+        return;
+    }
+
+#    if defined(CONSOLE_ENABLE)
+    // uint32_t is unsigned int on 64 bit hosts
+    dprintf("keystroke cost p50: %lu p99: %lu, ", (unsigned long)keystroke_cost_percentile(keystroke_costs, 50), (unsigned long)keystroke_cost_percentile(keystroke_costs, 99));
+    dprintf("latency p50: %lums p99: %lums, ", (unsigned long)keystroke_cost_percentile(keystroke_latencies, 50), (unsigned long)keystroke_cost_percentile(keystroke_latencies, 99));
+    dprintf("reports per 100 keystrokes: %lu\n", (unsigned long)(keystroke_reports * 100 / KEYSTROKE_COST_SAMPLES));
+#    endif
+    keystroke_count   = 0;
+    keystroke_reports = 0;
+}
+#else
+#    define keystroke_cost_exec(event) action_exec(event)
+#endif
+
 #ifdef MATRIX_HAS_GHOST
-static matrix_row_t get_real_keys(uint8_t row, matrix_row_t rowdata) {
-    matrix_row_t out = 0;
-    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
-        // read each key in the row data and check if the keymap defines it as a real key
-        if (keycode_at_keymap_location(0, row, col) && (rowdata & (((matrix_row_t)1) << col))) {
-            // this creates new row data, if a key is defined in the keymap, it will be set here
-            out |= ((matrix_row_t)1) << col;
+/*
+ * Keys defined in layer 0 for each row, rebuilt on the first ghost check
+ * after the keymap changed instead of reading the keymap per column on
+ * every check. With KEY_EVENT_QUEUE_EXTERNAL_SCAN the scan runs in an
+ * interrupt and must not read the keymap: key_event_task() rebuilds them,
+ * and the scan leaves the changed rows pending until then.
+ */
+static matrix_row_t     real_keys[MATRIX_ROWS];
+static volatile bool    real_keys_valid      = false;
+static volatile uint8_t real_keys_generation = 0;
+
+void ghost_real_keys_invalidate(void) {
+    real_keys_valid = false;
+    real_keys_generation++;
+}
+
+static void update_real_keys(void) {
+    const uint8_t generation = real_keys_generation;
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t keys = 0;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            // check if the keymap defines it as a real key
+            if (keycode_at_keymap_location(0, row, col)) {
+                keys |= ((matrix_row_t)1) << col;
+            }
         }
+        real_keys[row] = keys;
+    }
+    // published once complete, an invalidation while updating forces another update
+    __atomic_store_n(&real_keys_valid, generation == real_keys_generation, __ATOMIC_RELEASE);
+}
+
+static inline void ghost_real_keys_task(void) {
+    if (!real_keys_valid) {
+        update_real_keys();
     }
-    return out;
+}
+
+static inline matrix_row_t get_real_keys(uint8_t row, matrix_row_t rowdata) {
+    // keys that are pressed and defined in the keymap
+    return real_keys[row] & rowdata;
 }
 
 static inline bool popcount_more_than_one(matrix_row_t rowdata) {
@@ -245,6 +353,13 @@ static inline bool has_ghost_in_row(uint8_t row, matrix_row_t rowdata) {
     If there are "active" blanks in the matrix, the key can't be pressed by the user,
     there is no doubt as to which keys are really being pressed.
     The ghosts will be ignored, they are KC_NO.   */
+#    ifdef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+    if (!__atomic_load_n(&real_keys_valid, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+#    else
+    ghost_real_keys_task();
+#    endif
     rowdata = get_real_keys(row, rowdata);
     if ((popcount_more_than_one(rowdata)) == 0) {
         return false;
@@ -266,6 +381,10 @@ static inline bool has_ghost_in_row(uint8_t row, matrix_row_t rowdata) {
 
 #else
 
+void ghost_real_keys_invalidate(void) {}
+
+#    define ghost_real_keys_task()
+
 static inline bool has_ghost_in_row(uint8_t row, matrix_row_t rowdata) {
     return false;
 }
@@ -325,6 +444,10 @@ void keyboard_setup(void) {
 #ifdef EEPROM_DRIVER
     eeprom_driver_init();
 #endif
+#ifdef DYNAMIC_KEYMAP_ENABLE
+    dynamic_keymap_cache_init();
+    dynamic_keymap_macro_init();
+#endif
 #ifdef VIAL_ENABLE
     vial_init();
 #endif
@@ -498,7 +621,7 @@ void keyboard_init(void) {
     haptic_init();
 #endif
 
-#if defined(DEBUG_MATRIX_SCAN_RATE) && defined(CONSOLE_ENABLE)
+#if (defined(DEBUG_MATRIX_SCAN_RATE) || defined(DEBUG_KEYSTROKE_COST)) && defined(CONSOLE_ENABLE)
     debug_enable = true;
 #endif
 
@@ -523,53 +646,319 @@ void switch_events(uint8_t row, uint8_t col, bool pressed) {
 #endif
 }
 
+#ifdef DEADLINE_TICK_ENABLE
+#    ifndef DEADLINE_TICK_TAPPING_TERM
+#        define DEADLINE_TICK_TAPPING_TERM QS_tapping_term
+#    endif
+
+#    ifndef DEADLINE_TICK_LEADER_TIMEOUT
+#        ifdef LEADER_TIMEOUT
+#            define DEADLINE_TICK_LEADER_TIMEOUT LEADER_TIMEOUT
+#        else
+#            define DEADLINE_TICK_LEADER_TIMEOUT 300
+#        endif
+#    endif
+
+#    ifndef TICK_DEADLINE_DEPTH
+#        define TICK_DEADLINE_DEPTH 8
+#    endif
+
+/*
+ * Every deadline keeps its pending due times in order, so a second key
+ * inside the tapping term does not postpone the tick the first one needs.
+ * When they do not fit, ticks are generated every millisecond until the
+ * latest due time dropped has passed.
+ */
+typedef struct {
+    uint16_t due[TICK_DEADLINE_DEPTH];
+    uint8_t  count;
+    bool     flood;
+    uint16_t flood_until;
+} tick_deadline_slot_t;
+
+static tick_deadline_slot_t tick_deadlines[TICK_DEADLINE_COUNT];
+
+static inline bool tick_deadline_passed(uint16_t now, uint16_t due) {
+    return TIMER_DIFF_16(now, due) < 0x8000;
+}
+
+static void tick_deadline_arm(tick_deadline_t deadline, uint16_t start, uint16_t timeout) {
+    if (deadline >= TICK_DEADLINE_COUNT) return;
+    tick_deadline_slot_t *slot = &tick_deadlines[deadline];
+    const uint16_t        now  = timer_read();
+    // expire strictly after the timeout, as the timers are compared with "<" against it
+    const uint16_t due  = start + timeout + 1;
+    const int16_t  left = (int16_t)(due - now);
+
+    uint8_t i = slot->count;
+    while (i > 0 && (int16_t)(slot->due[i - 1] - now) > left) {
+        i--;
+    }
+    if (i > 0 && slot->due[i - 1] == due) {
+        return;
+    }
+    if (slot->count == TICK_DEADLINE_DEPTH) {
+        if (!slot->flood || left > (int16_t)(slot->flood_until - now)) {
+            slot->flood_until = due;
+        }
+        slot->flood = true;
+        return;
+    }
+
+    memmove(&slot->due[i + 1], &slot->due[i], (slot->count - i) * sizeof(slot->due[0]));
+    slot->due[i] = due;
+    slot->count++;
+}
+
+void tick_deadline_set(tick_deadline_t deadline, uint16_t timeout) {
+    tick_deadline_arm(deadline, timer_read(), timeout);
+}
+
+void tick_deadline_clear(tick_deadline_t deadline) {
+    if (deadline >= TICK_DEADLINE_COUNT) return;
+    tick_deadlines[deadline].count = 0;
+    tick_deadlines[deadline].flood = false;
+}
+
+bool tick_deadline_armed(void) {
+    for (uint8_t i = 0; i < TICK_DEADLINE_COUNT; i++) {
+        if (tick_deadlines[i].count || tick_deadlines[i].flood) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Arms the deadlines of the timers started by a key event, called
+ * by action_exec() once the event is processed
+ *
+ * The tapping term runs from the time of the event, as the tapping state
+ * machine compares against it. The other timers are started while the
+ * event is processed, so they run from now.
+ */
+void tick_deadline_key_event(keyrecord_t *record) {
+    const uint16_t now     = timer_read();
+    const uint16_t keycode = get_event_keycode(record->event, false);
+
+#    if defined(TAPPING_TERM_PER_KEY) || defined(DYNAMIC_TAPPING_TERM_ENABLE)
+    // also the timeout of a tap dance key
+    tick_deadline_arm(TICK_DEADLINE_TAPPING, record->event.time, get_tapping_term(keycode, record));
+#    else
+    tick_deadline_arm(TICK_DEADLINE_TAPPING, record->event.time, DEADLINE_TICK_TAPPING_TERM);
+#    endif
+#    ifndef NO_ACTION_ONESHOT
+    if (QS_oneshot_timeout > 0 && (get_oneshot_mods() || is_oneshot_layer_active())) {
+        tick_deadline_arm(TICK_DEADLINE_ONESHOT, now, QS_oneshot_timeout);
+    }
+#    endif
+#    ifdef COMBO_ENABLE
+    if (record->event.pressed) {
+        tick_deadline_arm(TICK_DEADLINE_COMBO, now, COMBO_TERM);
+    }
+#    endif
+#    ifdef AUTO_SHIFT_ENABLE
+    if (record->event.pressed && get_autoshift_state()) {
+        tick_deadline_arm(TICK_DEADLINE_FEATURE, now, get_autoshift_timeout(keycode, record));
+    }
+#    endif
+#    ifdef LEADER_ENABLE
+    if (leader_sequence_active()) {
+        tick_deadline_arm(TICK_DEADLINE_FEATURE, now, DEADLINE_TICK_LEADER_TIMEOUT);
+    }
+#    endif
+}
+
+/**
+ * @brief Checks for expired deadlines, and drops them
+ *
+ * @return true at least one deadline expired
+ */
+static bool tick_deadline_expired(uint16_t now) {
+    bool expired = false;
+    for (uint8_t i = 0; i < TICK_DEADLINE_COUNT; i++) {
+        tick_deadline_slot_t *slot   = &tick_deadlines[i];
+        uint8_t               passed = 0;
+        while (passed < slot->count && tick_deadline_passed(now, slot->due[passed])) {
+            passed++;
+        }
+        if (passed) {
+            slot->count -= passed;
+            memmove(&slot->due[0], &slot->due[passed], slot->count * sizeof(slot->due[0]));
+            expired = true;
+        }
+        if (slot->flood) {
+            slot->flood = !tick_deadline_passed(now, slot->flood_until);
+            expired     = true;
+        }
+    }
+    return expired;
+}
+#endif
+
 /**
  * @brief Generates a tick event at a maximum rate of 1KHz that drives the
- * internal QMK state machine.
+ * internal QMK state machine. With DEADLINE_TICK_ENABLE the event is only
+ * generated when a registered deadline expires.
  */
 static inline void generate_tick_event(void) {
     static uint16_t last_tick = 0;
     const uint16_t  now       = timer_read();
     if (TIMER_DIFF_16(now, last_tick) != 0) {
+#ifdef DEADLINE_TICK_ENABLE
+        if (!tick_deadline_expired(now)) {
+            return;
+        }
+#endif
         action_exec(MAKE_TICK_EVENT);
         last_tick = now;
     }
 }
 
+/**
+ * @brief Time of the scan which last changed the raw row, so the key events
+ * carry the time of the physical edge. Overridden by the matrix scanner.
+ */
+__attribute__((weak)) uint16_t matrix_get_row_time(uint8_t row) {
+    return timer_read();
+}
+
+#ifdef KEY_EVENT_QUEUE_ENABLE
+#    ifndef KEY_EVENT_QUEUE_SIZE
+#        define KEY_EVENT_QUEUE_SIZE 32
+#    endif
+_Static_assert(KEY_EVENT_QUEUE_SIZE && (KEY_EVENT_QUEUE_SIZE & (KEY_EVENT_QUEUE_SIZE - 1)) == 0, "KEY_EVENT_QUEUE_SIZE must be a power of two");
+_Static_assert(KEY_EVENT_QUEUE_SIZE <= 128, "KEY_EVENT_QUEUE_SIZE must fit the 8 bit ring indexes");
+
+/*
+ * The head is only written by the consumer and the tail only by the
+ * producer, both free running and masked on access. The release store of
+ * an index publishes the slot it covers, so no lock is needed as long as
+ * there is exactly one context on each side.
+ */
+static keyevent_t key_event_ring[KEY_EVENT_QUEUE_SIZE];
+static uint8_t    key_event_head = 0;
+static uint8_t    key_event_tail = 0;
+static uint32_t   key_event_overflow_count = 0;
+static uint8_t    key_event_high_water_mark = 0;
+
+uint32_t key_event_queue_overflows(void) {
+    return __atomic_load_n(&key_event_overflow_count, __ATOMIC_RELAXED);
+}
+
+uint8_t key_event_queue_high_water(void) {
+    return __atomic_load_n(&key_event_high_water_mark, __ATOMIC_RELAXED);
+}
+
+static bool key_event_queue_push(keyevent_t event) {
+    const uint8_t tail = key_event_tail;
+    const uint8_t used = tail - __atomic_load_n(&key_event_head, __ATOMIC_ACQUIRE);
+    if (used >= KEY_EVENT_QUEUE_SIZE) {
+        __atomic_store_n(&key_event_overflow_count, key_event_overflow_count + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    key_event_ring[tail & (KEY_EVENT_QUEUE_SIZE - 1)] = event;
+    __atomic_store_n(&key_event_tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+    if (used + 1 > key_event_high_water_mark) {
+        __atomic_store_n(&key_event_high_water_mark, used + 1, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+static bool key_event_queue_pop(keyevent_t *event) {
+    const uint8_t head = key_event_head;
+    if (head == __atomic_load_n(&key_event_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    *event = key_event_ring[head & (KEY_EVENT_QUEUE_SIZE - 1)];
+    __atomic_store_n(&key_event_head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+    return true;
+}
+
+// the consumer generates the tick events, it owns the action state
+#    define matrix_tick_event()
+#else
+#    define matrix_tick_event() generate_tick_event()
+#endif
+
+#ifdef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+#    include "debounce.h"
+
+// the matrix buffers of quantum/matrix_common.c
+extern matrix_row_t raw_matrix[MATRIX_ROWS];
+extern matrix_row_t matrix[MATRIX_ROWS];
+
+/**
+ * @brief Interrupt side of matrix_scan(), only the raw scan and the debounce.
+ * The matrix_scan_kb() hooks run in key_event_task() instead. Written for
+ * CUSTOM_MATRIX = lite, other matrices have to override it.
+ */
+__attribute__((weak)) bool matrix_scan_isr(void) {
+    bool changed = matrix_scan_custom(raw_matrix);
+    return debounce(raw_matrix, matrix, MATRIX_ROWS, changed);
+}
+
+// the scan rate and its debug output are counted by key_event_task()
+#    define matrix_scan_step() matrix_scan_isr()
+#    define matrix_scan_report()
+#else
+#    define matrix_scan_step() matrix_scan()
+#    define matrix_scan_report() matrix_scan_perf_task()
+#endif
+
+/**
+ * @brief Processes a key event of the matrix.
+ */
+static void matrix_key_event(keyevent_t event) {
+#if defined(DYNAMIC_KEYMAP_MACRO_ASYNC_ENABLE) && defined(DYNAMIC_KEYMAP_MACRO_CANCEL_ON_KEYPRESS)
+    if (event.pressed) {
+        dynamic_keymap_macro_cancel();
+    }
+#endif
+    keystroke_cost_exec(event);
+}
+
 /**
  * @brief This task scans the keyboards matrix and processes any key presses
- * that occur.
+ * that occur. With KEY_EVENT_QUEUE_ENABLE the key presses are only queued
+ * for key_event_task().
  *
  * @return true Matrix did change
  * @return false Matrix didn't change
  */
 static bool matrix_task(void) {
     if (!matrix_can_read()) {
-        generate_tick_event();
+        matrix_tick_event();
         return false;
     }
 
     static matrix_row_t matrix_previous[MATRIX_ROWS];
 
-    matrix_scan();
+    matrix_scan_step();
     bool matrix_changed = false;
     for (uint8_t row = 0; row < MATRIX_ROWS && !matrix_changed; row++) {
         matrix_changed |= matrix_previous[row] ^ matrix_get_row(row);
     }
 
-    matrix_scan_perf_task();
+    matrix_scan_report();
 
     // Short-circuit the complete matrix processing if it is not necessary
     if (!matrix_changed) {
-        generate_tick_event();
+        matrix_tick_event();
         return matrix_changed;
     }
 
+#ifndef KEY_EVENT_QUEUE_EXTERNAL_SCAN
     if (debug_config.matrix) {
         matrix_print();
     }
+#endif
 
+#ifndef KEY_EVENT_QUEUE_ENABLE
     const bool process_keypress = should_process_keypress();
+#endif
 
     for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
         const matrix_row_t current_row = matrix_get_row(row);
@@ -583,21 +972,86 @@ static bool matrix_task(void) {
         for (uint8_t col = 0; col < MATRIX_COLS; col++, col_mask <<= 1) {
             if (row_changes & col_mask) {
                 const bool key_pressed = current_row & col_mask;
+                keyevent_t event       = MAKE_KEYEVENT(row, col, key_pressed);
+                event.time             = matrix_get_row_time(row) | 1;
 
+#ifdef KEY_EVENT_QUEUE_ENABLE
+                if (!key_event_queue_push(event)) {
+                    // ring is full, the rest stays pending for the next scan
+                    return matrix_changed;
+                }
+#else
+#    ifdef HOST_REPORT_QUEUE_ENABLE
+                // the rest stays pending while the keyboard reports are backed up
+                if (host_queue_full(HOST_ENDPOINT_KEYBOARD)) {
+                    return matrix_changed;
+                }
+#    endif
                 if (process_keypress) {
-                    action_exec(MAKE_KEYEVENT(row, col, key_pressed));
+                    matrix_key_event(event);
                 }
 
                 switch_events(row, col, key_pressed);
+#endif
+                matrix_previous[row] ^= col_mask;
             }
         }
-
-        matrix_previous[row] = current_row;
     }
 
     return matrix_changed;
 }
 
+#ifdef KEY_EVENT_QUEUE_ENABLE
+bool keyboard_scan_task(void) {
+    return matrix_task();
+}
+
+/**
+ * @brief Processes the key events queued by the matrix scan, or generates
+ * the tick event when there are none.
+ *
+ * @return true Some key event was processed
+ */
+static bool key_event_task(void) {
+#    ifdef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+    // the parts of the scan which are not interrupt safe
+    ghost_real_keys_task();
+    matrix_scan_kb();
+    matrix_scan_perf_task();
+#    endif
+
+#    ifdef HOST_REPORT_QUEUE_ENABLE
+    // the key events wait in their queue while the keyboard reports are backed up
+    if (host_queue_full(HOST_ENDPOINT_KEYBOARD)) {
+        return false;
+    }
+#    endif
+
+    const bool processed        = __atomic_load_n(&key_event_tail, __ATOMIC_ACQUIRE) != key_event_head;
+    const bool process_keypress = processed && should_process_keypress();
+
+#    ifdef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+    if (processed && debug_config.matrix) {
+        matrix_print();
+    }
+#    endif
+
+    keyevent_t event;
+    while (key_event_queue_pop(&event)) {
+        if (process_keypress) {
+            matrix_key_event(event);
+        }
+
+        switch_events(event.key.row, event.key.col, event.pressed);
+    }
+
+    if (!processed) {
+        generate_tick_event();
+    }
+    return processed;
+}
+#endif
+
 /** \brief Tasks previously located in matrix_scan_quantum
  *
  * TODO: rationalise against keyboard_task and current split role
@@ -676,13 +1130,31 @@ void quantum_task(void) {
 /** \brief Main task that is repeatedly called as fast as possible. */
 void keyboard_task(void) {
     __attribute__((unused)) bool activity_has_occurred = false;
+#ifdef REPORT_SCHEDULER_ENABLE
+    host_report_task();
+#endif
+#ifdef KEY_EVENT_QUEUE_ENABLE
+#    ifndef KEY_EVENT_QUEUE_EXTERNAL_SCAN
+    keyboard_scan_task();
+#    endif
+    if (key_event_task()) {
+#else
     if (matrix_task()) {
+#endif
         last_matrix_activity_trigger();
         activity_has_occurred = true;
     }
 
     quantum_task();
 
+#if defined(DYNAMIC_KEYMAP_ENABLE) && defined(DYNAMIC_KEYMAP_MACRO_ASYNC_ENABLE)
+    dynamic_keymap_macro_task();
+#endif
+
+#ifdef LOG_STORE_ENABLE
+    log_store_task();
+#endif
+
 #if defined(SPLIT_WATCHDOG_ENABLE)
     split_watchdog_task();
 #endif
@@ -764,4 +1236,15 @@ void keyboard_task(void) {
 #ifdef OS_DETECTION_ENABLE
     os_detection_task();
 #endif
+
+#ifdef HOST_REPORT_COMMIT_ENABLE
+    // last, so everything processed in this pass goes out in one report
+    host_report_commit_task();
+#endif
+#ifdef HOST_MOUSE_ACCUMULATE_ENABLE
+    host_mouse_task();
+#endif
+#ifdef HOST_REPORT_QUEUE_ENABLE
+    host_queue_task();
+#endif
 }
@@ -0,0 +1,22 @@
+/**
+ * @file keyboard.h
+ * @author astro
+ *  additions to the quantum keyboard.h for protocol/keyboard.c
+ *
+ * Takes the place of the quantum header and pulls it in with include_next,
+ * so protocol/ has to stay in front of quantum/ in the include path.
+ */
+
+#pragma once
+
+#include_next "keyboard.h"
+
+/* drop the cached real key masks of the ghost detection, whenever the keymap changes */
+void ghost_real_keys_invalidate(void);
+
+#ifdef DEBUG_KEYSTROKE_COST
+/* count a report sent for the keystroke being measured */
+void keystroke_cost_report_sent(void);
+#else
+#    define keystroke_cost_report_sent()
+#endif
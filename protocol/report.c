@@ -32,24 +32,88 @@ static int8_t cb_tail  = 0;
 static int8_t cb_count = 0;
 #endif
 
-/** \brief has_anykey
- *
- * FIXME: Needs doc
+/*
+ * Shadow of the usages in the active report, keyboard_report in 6KRO or
+ * nkro_report in NKRO, kept by the functions here when they change that
+ * report. A switch of the report mode rebuilds it from the report then
+ * active. Reports edited directly go through clear_keys_from_report().
  */
-uint8_t has_anykey(void) {
-    uint8_t  cnt = 0;
-    uint8_t* p   = keyboard_report->keys;
-    uint8_t  lp  = sizeof(keyboard_report->keys);
+static uint32_t key_shadow[256 / 32];
+static uint8_t  key_shadow_count = 0;
+static bool     key_shadow_nkro  = false;
+
+static inline bool key_shadow_has(uint8_t code) {
+    return key_shadow[code >> 5] & (1UL << (code & 31));
+}
+
+static inline void key_shadow_add(uint8_t code) {
+    if (code != KC_NO && !key_shadow_has(code)) {
+        key_shadow[code >> 5] |= 1UL << (code & 31);
+        key_shadow_count++;
+    }
+}
+
+static inline void key_shadow_del(uint8_t code) {
+    if (key_shadow_has(code)) {
+        key_shadow[code >> 5] &= ~(1UL << (code & 31));
+        key_shadow_count--;
+    }
+}
+
+static inline bool key_report_nkro(void) {
 #ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        p  = nkro_report->bits;
-        lp = sizeof(nkro_report->bits);
+    return keyboard_protocol && keymap_config.nkro;
+#else
+    return false;
+#endif
+}
+
+// rebuilds the shadow when the report mode changed since it was kept
+static void key_shadow_sync(void) {
+    bool nkro = key_report_nkro();
+    if (nkro == key_shadow_nkro) {
+        return;
+    }
+
+    key_shadow_nkro = nkro;
+    memset(key_shadow, 0, sizeof(key_shadow));
+    key_shadow_count = 0;
+#ifdef NKRO_ENABLE
+    if (nkro) {
+        for (uint16_t code = 0; code < NKRO_REPORT_BITS * 8; code++) {
+            if (nkro_report->bits[code >> 3] & 1 << (code & 7)) {
+                key_shadow_add(code);
+            }
+        }
+        return;
     }
 #endif
-    while (lp--) {
-        if (*p++) cnt++;
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        key_shadow_add(keyboard_report->keys[i]);
     }
-    return cnt;
+}
+
+// the report is the active one, which the shadow follows
+static bool key_shadow_tracks_byte(const report_keyboard_t* report) {
+    key_shadow_sync();
+    return report == keyboard_report && !key_shadow_nkro;
+}
+
+#ifdef NKRO_ENABLE
+static bool key_shadow_tracks_bit(const report_nkro_t* report) {
+    key_shadow_sync();
+    return report == nkro_report && key_shadow_nkro;
+}
+#endif
+
+/** \brief has_anykey
+ *
+ * Returns the number of keys in the active report, modifiers not counted.
+ * Read from the key shadow, the same cost in 6KRO and NKRO.
+ */
+uint8_t has_anykey(void) {
+    key_shadow_sync();
+    return key_shadow_count;
 }
 
 /** \brief get_first_key
@@ -57,12 +121,17 @@ uint8_t has_anykey(void) {
  * FIXME: Needs doc
  */
 uint8_t get_first_key(void) {
+    key_shadow_sync();
+    if (!key_shadow_count) {
+        return KC_NO;
+    }
 #ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
+    if (key_shadow_nkro) {
+        // the lowest usage, nkro has no order
         uint8_t i = 0;
-        for (; i < NKRO_REPORT_BITS && !nkro_report->bits[i]; i++)
+        for (; !key_shadow[i]; i++)
             ;
-        return i << 3 | biton(nkro_report->bits[i]);
+        return i << 5 | __builtin_ctzl(key_shadow[i]);
     }
 #endif
 #ifdef RING_BUFFERED_6KRO_REPORT_ENABLE
@@ -88,21 +157,8 @@ bool is_key_pressed(uint8_t key) {
     if (key == KC_NO) {
         return false;
     }
-#ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        if ((key >> 3) < NKRO_REPORT_BITS) {
-            return nkro_report->bits[key >> 3] & 1 << (key & 7);
-        } else {
-            return false;
-        }
-    }
-#endif
-    for (int i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (keyboard_report->keys[i] == key) {
-            return true;
-        }
-    }
-    return false;
+    key_shadow_sync();
+    return key_shadow_has(key);
 }
 
 /** \brief add key byte
@@ -110,6 +166,7 @@ bool is_key_pressed(uint8_t key) {
  * FIXME: Needs doc
  */
 void add_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
+    const bool tracked = key_shadow_tracks_byte(keyboard_report);
 #ifdef RING_BUFFERED_6KRO_REPORT_ENABLE
     int8_t i     = cb_head;
     int8_t empty = -1;
@@ -128,6 +185,9 @@ void add_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
                 // buffer is full
                 if (empty == -1) {
                     // pop head when has no empty space
+                    if (tracked) {
+                        key_shadow_del(keyboard_report->keys[cb_head]);
+                    }
                     cb_head = RO_INC(cb_head);
                     cb_count--;
                 } else {
@@ -153,6 +213,9 @@ void add_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
     keyboard_report->keys[cb_tail] = code;
     cb_tail                        = RO_INC(cb_tail);
     cb_count++;
+    if (tracked) {
+        key_shadow_add(code);
+    }
 #else
     int8_t i     = 0;
     int8_t empty = -1;
@@ -167,6 +230,9 @@ void add_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
     if (i == KEYBOARD_REPORT_KEYS) {
         if (empty != -1) {
             keyboard_report->keys[empty] = code;
+            if (tracked) {
+                key_shadow_add(code);
+            }
         }
     }
 #endif
@@ -177,12 +243,16 @@ void add_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
  * FIXME: Needs doc
  */
 void del_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
+    const bool tracked = key_shadow_tracks_byte(keyboard_report);
 #ifdef RING_BUFFERED_6KRO_REPORT_ENABLE
     uint8_t i = cb_head;
     if (cb_count) {
         do {
             if (keyboard_report->keys[i] == code) {
                 keyboard_report->keys[i] = 0;
+                if (tracked) {
+                    key_shadow_del(code);
+                }
                 cb_count--;
                 if (cb_count == 0) {
                     // reset head and tail
@@ -206,6 +276,9 @@ void del_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
     for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
         if (keyboard_report->keys[i] == code) {
             keyboard_report->keys[i] = 0;
+            if (tracked) {
+                key_shadow_del(code);
+            }
         }
     }
 #endif
@@ -219,6 +292,9 @@ void del_key_byte(report_keyboard_t* keyboard_report, uint8_t code) {
 void add_key_bit(report_nkro_t* nkro_report, uint8_t code) {
     if ((code >> 3) < NKRO_REPORT_BITS) {
         nkro_report->bits[code >> 3] |= 1 << (code & 7);
+        if (key_shadow_tracks_bit(nkro_report)) {
+            key_shadow_add(code);
+        }
     } else {
         dprintf("add_key_bit: can't add: %02X\n", code);
     }
@@ -231,6 +307,9 @@ void add_key_bit(report_nkro_t* nkro_report, uint8_t code) {
 void del_key_bit(report_nkro_t* nkro_report, uint8_t code) {
     if ((code >> 3) < NKRO_REPORT_BITS) {
         nkro_report->bits[code >> 3] &= ~(1 << (code & 7));
+        if (key_shadow_tracks_bit(nkro_report)) {
+            key_shadow_del(code);
+        }
     } else {
         dprintf("del_key_bit: can't del: %02X\n", code);
     }
@@ -271,8 +350,16 @@ void del_key_from_report(uint8_t key) {
  */
 void clear_keys_from_report(void) {
     // not clear mods
+    memset(key_shadow, 0, sizeof(key_shadow));
+    key_shadow_count = 0;
+    key_shadow_nkro  = key_report_nkro();
+#ifdef RING_BUFFERED_6KRO_REPORT_ENABLE
+    // the cursors have to describe the emptied keys[], left as they were
+    // cb_count keeps counting the cleared keys and never drops back to 0
+    cb_head = cb_tail = cb_count = 0;
+#endif
 #ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
+    if (key_shadow_nkro) {
         memset(nkro_report->bits, 0, sizeof(nkro_report->bits));
         return;
     }
@@ -23,10 +23,7 @@
 #include "keycode.h"
 #include "action.h"
 #include "wait.h"
-
-// for delay report
-#include "usb_common.h"
-#include "usb_interface.h"
+#include "host.h"
 
 #if defined(AUDIO_ENABLE) && defined(SENDSTRING_BELL)
 #    include "audio.h"
@@ -185,12 +182,12 @@ void send_string_with_delay(const char *string, uint8_t interval) {
                 }
                 //wait_ms(ms);
                 uint16_t delay = (uint16_t)ms;
-                usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
+                amk_report_delay(delay);
             }
 
             //wait_ms(interval);
             uint16_t delay = (uint16_t)interval;
-            usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
+            amk_report_delay(delay);
         } else {
             send_char_with_delay(ascii_code, interval);
         }
@@ -216,44 +213,32 @@ void send_char_with_delay(char ascii_code, uint8_t interval) {
     bool    is_altgred = PGM_LOADBIT(ascii_to_altgr_lut, (uint8_t)ascii_code);
     bool    is_dead    = PGM_LOADBIT(ascii_to_dead_lut, (uint8_t)ascii_code);
 
+    // The modifiers go down in the report of the key and up in the one of its
+    // release, the delay of the tap sends the first one.
+    report_begin();
     if (is_shifted) {
         register_code(KC_LEFT_SHIFT);
-        //wait_ms(interval);
-        uint16_t delay = (uint16_t)interval;
-        usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
     }
-
     if (is_altgred) {
         register_code(KC_RIGHT_ALT);
-        //wait_ms(interval);
-        uint16_t delay = (uint16_t)interval;
-        usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
     }
-
     tap_code_delay(keycode, interval);
-    //wait_ms(interval);
-    uint16_t delay = (uint16_t)interval;
-    usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
-
     if (is_altgred) {
         unregister_code(KC_RIGHT_ALT);
-        //wait_ms(interval);
-        uint16_t delay = (uint16_t)interval;
-        usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
     }
-
     if (is_shifted) {
         unregister_code(KC_LEFT_SHIFT);
-        //wait_ms(interval);
-        uint16_t delay = (uint16_t)interval;
-        usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
     }
+    report_commit();
+    //wait_ms(interval);
+    uint16_t delay = (uint16_t)interval;
+    amk_report_delay(delay);
 
     if (is_dead) {
         tap_code(KC_SPACE);
         //wait_ms(interval);
         uint16_t delay = (uint16_t)interval;
-        usb_send_report(HID_REPORT_ID_DELAY, &delay, sizeof(delay));
+        amk_report_delay(delay);
     }
 }
 
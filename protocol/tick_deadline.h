@@ -0,0 +1,35 @@
+/**
+ * @file tick_deadline.h
+ * @author astro
+ *  deadline registry driving the keyboard tick event
+ *
+ * With DEADLINE_TICK_ENABLE the tick event is no longer generated every
+ * millisecond, but only when one of the registered deadlines expires.
+ * Every key event processed by action_exec() arms the tapping, oneshot,
+ * combo and feature deadlines it started, with the per key tapping term
+ * when there is one. Keymaps with timers of their own can arm the user
+ * deadline.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "action.h"
+
+typedef enum {
+    TICK_DEADLINE_TAPPING,
+    TICK_DEADLINE_ONESHOT,
+    TICK_DEADLINE_COMBO,
+    TICK_DEADLINE_FEATURE,
+    TICK_DEADLINE_USER,
+    TICK_DEADLINE_COUNT,
+} tick_deadline_t;
+
+/* arm the deadline to expire timeout milliseconds from now */
+void tick_deadline_set(tick_deadline_t deadline, uint16_t timeout);
+void tick_deadline_clear(tick_deadline_t deadline);
+bool tick_deadline_armed(void);
+
+/* arm the deadlines of the timers started by a key event, once it is processed */
+void tick_deadline_key_event(keyrecord_t *record);
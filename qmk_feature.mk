@@ -1,4 +1,6 @@
 
+QMK_LIB_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+
 INCS += $(QMK_DIR)/quantum/process_keycode
 
 SPACE_CADET_ENABLE ?= yes
@@ -55,10 +57,17 @@ $(foreach F,$(GENERIC_FEATURES),\
 )
 
 DEBOUNCE_TYPE ?= sym_defer_g
-ifneq ($(strip $(DEBOUNCE_TYPE)), custom)
+ifeq ($(strip $(DEBOUNCE_TYPE)), bitslice_eager_pk)
+    SRCS += $(QMK_LIB_DIR)/portable/debounce_bitslice.c
+else ifneq ($(strip $(DEBOUNCE_TYPE)), custom)
     SRCS += $(QMK_DIR)/quantum/debounce/$(strip $(DEBOUNCE_TYPE)).c
 endif
 
+ifeq ($(strip $(LOG_STORE_ENABLE)), yes)
+    APP_DEFS += -DLOG_STORE_ENABLE
+    SRCS += $(QMK_LIB_DIR)/portable/log_store.c
+endif
+
 ifeq ($(strip $(RGB_MATRIX_ENABLE)), yes)
     APP_DEFS += -DRGB_MATRIX_ENABLE
     SRCS += $(QMK_DIR)/quantum/color.c
@@ -0,0 +1,111 @@
+# Host native build of protocol/ and portable/ against the vial-qmk submodule,
+# for measuring on a workstation before flashing. The gpio, eeprom, timer and
+# usb_send_report are the in memory stand-ins of portable/host.
+#
+#   make -f qmk_host.mk KEYBOARD_DIR=<dir with config.h and keymap.c>
+#
+# builds $(HOST_BUILD_DIR)/libqmk_host.a. A workstation program links against
+# it, drives host_platform.h and calls qmk_driver_init()/qmk_driver_task().
+# portable/matrix_scan.c is always the matrix, as a CUSTOM_MATRIX = lite one.
+# HOST_DEFS adds defines to the whole build.
+#
+#   make -f qmk_host.mk test
+#   make -f qmk_host.mk bench
+#
+# build and run the programs of portable/host/tests listed in its tests.mk,
+# see there. They bring their own keyboard, KEYBOARD_DIR is not needed.
+
+QMK_LIB_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+QMK_DIR ?= $(QMK_LIB_DIR)/vial-qmk
+HOST_DIR := $(QMK_LIB_DIR)/portable/host
+HOST_BUILD_DIR ?= $(QMK_LIB_DIR)/_host_build
+HOST_TEST_DIR := $(HOST_DIR)/tests
+HOST_TEST_KEYBOARD := $(HOST_TEST_DIR)/keyboard
+
+ifneq ($(filter test bench test-%,$(MAKECMDGOALS)),)
+KEYBOARD_DIR ?= $(HOST_TEST_KEYBOARD)
+endif
+
+ifeq ($(strip $(KEYBOARD_DIR)),)
+$(error KEYBOARD_DIR must point to the keyboard config.h and keymap.c)
+endif
+
+HOST_CC ?= cc
+HOST_AR ?= ar
+
+SRCS :=
+INCS :=
+APP_DEFS :=
+
+DYNAMIC_KEYMAP_ENABLE ?= yes
+
+# same sources as the firmware build, with the platform swapped out
+SRCS += $(wildcard $(QMK_LIB_DIR)/protocol/*.c)
+SRCS += $(QMK_LIB_DIR)/portable/matrix_scan.c
+SRCS += $(QMK_LIB_DIR)/portable/qmk_driver.c
+SRCS += $(HOST_DIR)/host_platform.c
+
+SRCS += \
+	$(QMK_DIR)/quantum/action_layer.c \
+	$(QMK_DIR)/quantum/action_tapping.c \
+	$(QMK_DIR)/quantum/action_util.c \
+	$(QMK_DIR)/quantum/bitwise.c \
+	$(QMK_DIR)/quantum/eeconfig.c \
+	$(QMK_DIR)/quantum/keycode_config.c \
+	$(QMK_DIR)/quantum/keymap_common.c \
+	$(QMK_DIR)/quantum/keymap_introspection.c \
+	$(QMK_DIR)/quantum/led.c \
+	$(QMK_DIR)/quantum/matrix_common.c \
+	$(QMK_DIR)/quantum/quantum.c \
+	$(QMK_DIR)/quantum/sync_timer.c \
+	$(QMK_DIR)/quantum/logging/debug.c \
+
+INCS += \
+	$(HOST_DIR) \
+	$(QMK_LIB_DIR)/portable \
+	$(QMK_LIB_DIR)/protocol \
+	$(KEYBOARD_DIR) \
+	$(QMK_DIR)/quantum \
+	$(QMK_DIR)/quantum/keymap_extras \
+	$(QMK_DIR)/quantum/logging \
+	$(QMK_DIR)/quantum/sequencer \
+	$(QMK_DIR)/platforms \
+	$(QMK_DIR)/tmk_core/protocol \
+
+ifeq ($(strip $(VIAL_ENABLE)), yes)
+    SRCS += $(wildcard $(QMK_DIR)/quantum/via.c $(QMK_DIR)/quantum/vial.c $(QMK_DIR)/quantum/qmk_settings.c)
+    APP_DEFS += -DVIA_ENABLE -DVIAL_ENABLE
+endif
+
+include $(QMK_LIB_DIR)/qmk_feature.mk
+
+# the files of protocol/ replace their quantum counterparts
+SRCS := $(sort $(filter-out $(addprefix $(QMK_DIR)/quantum/,$(notdir $(wildcard $(QMK_LIB_DIR)/protocol/*.c))),$(SRCS)))
+
+APP_DEFS += \
+	-DAMK_HOST_BUILD \
+	-DMATRIX_CUSTOM \
+	-DKEYMAP_C=\"$(abspath $(KEYBOARD_DIR))/keymap.c\" \
+	-include $(KEYBOARD_DIR)/config.h \
+
+APP_DEFS += $(HOST_DEFS)
+
+HOST_CFLAGS ?= -O2 -g -Wall
+HOST_OBJS := $(addprefix $(HOST_BUILD_DIR)/,$(notdir $(SRCS:.c=.o)))
+
+vpath %.c $(sort $(dir $(SRCS)))
+
+$(HOST_BUILD_DIR)/libqmk_host.a: $(HOST_OBJS)
+	$(HOST_AR) rcs $@ $^
+
+$(HOST_BUILD_DIR)/%.o: %.c | $(HOST_BUILD_DIR)
+	$(HOST_CC) $(HOST_CFLAGS) $(APP_DEFS) $(addprefix -I,$(INCS)) -c $< -o $@
+
+$(HOST_BUILD_DIR):
+	mkdir -p $@
+
+include $(HOST_TEST_DIR)/tests.mk
+
+.PHONY: clean
+clean:
+	rm -rf $(HOST_BUILD_DIR)